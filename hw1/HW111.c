@@ -1,3 +1,5 @@
+#define _GNU_SOURCE
+
 #include <unistd.h>
 #include <sys/time.h>
 #include <stdio.h>
@@ -5,15 +7,14 @@
 #include <string.h>
 #include <time.h>
 
-#define FILE_NAME       "100MB.bin"
-#define FILE_SIZE_MB    100
-#define FILE_SIZE       (FILE_SIZE_MB * 1024 * 1024)
-
-#define READ_CHUNK_SIZE     4096
-#define WRITE_CHUNK_SIZE    2048
+#include "bench_config.h"
+#include "lat_hist.h"
+#include "trace.h"
+#include "sys_acct.h"
 
 #define MEASURE_TIME(name, code_block) do {     \
     struct timeval __tv1, __tv2;                \
+    lat_phase_begin();                          \
     gettimeofday(&__tv1, NULL);                 \
     code_block                                  \
     gettimeofday(&__tv2, NULL);                 \
@@ -21,18 +22,142 @@
         1000000 * (__tv2.tv_sec - __tv1.tv_sec) \
         + (__tv2.tv_usec - __tv1.tv_usec);      \
     printf("%-25s:   %.4f sec\n", name, __diff / 1000000.0);  \
+    lat_phase_end();                            \
 } while (0); 
 
+/* Sums of the MEASURE_SYSCALLS phases, for the buffering summary */
+static double run_sec;
+static uint64_t run_syscalls;
+
+/*
+ * MEASURE_TIME plus the syscalls the C library issued for the phase. The
+ * counters are read outside the timed region, so the phase does not pay
+ * for measuring itself.
+ */
+#define MEASURE_SYSCALLS(name, code_block) do { \
+    struct timeval __tv1, __tv2;                \
+    lat_phase_begin();                          \
+    sys_acct_begin();                           \
+    gettimeofday(&__tv1, NULL);                 \
+    code_block                                  \
+    gettimeofday(&__tv2, NULL);                 \
+    sys_acct_end();                             \
+    unsigned long __diff =                      \
+        1000000 * (__tv2.tv_sec - __tv1.tv_sec) \
+        + (__tv2.tv_usec - __tv1.tv_usec);      \
+    printf("%-25s:   %.4f sec\n", name, __diff / 1000000.0);  \
+    lat_phase_end();                            \
+    sys_acct_print();                           \
+    run_sec += __diff / 1000000.0;              \
+    run_syscalls += sys_acct_rw_calls();        \
+} while (0);
+
+/* How the stream is buffered: setvbuf() type and size, and the buffer's origin */
+struct buf_mode {
+    const char *name;
+    int type;               /* _IOFBF, _IOLBF or _IONBF; -1 keeps the libc default */
+    size_t size;            /* 0: libc allocates (and sizes) the buffer */
+    int aligned;            /* page aligned buffer instead of malloc() */
+};
+
+static const struct buf_mode buf_modes[] = {
+    { "default",        -1,         0,          0 },
+    { "none",           _IONBF,     0,          0 },
+    { "line",           _IOLBF,     0,          0 },
+    { "4K",             _IOFBF,     4 << 10,    0 },
+    { "16K",            _IOFBF,     16 << 10,   0 },
+    { "64K",            _IOFBF,     64 << 10,   0 },
+    { "256K",           _IOFBF,     256 << 10,  0 },
+    { "1M",             _IOFBF,     1 << 20,    0 },
+    { "4M",             _IOFBF,     4 << 20,    0 },
+    { "16M",            _IOFBF,     16 << 20,   0 },
+    { "aligned-64K",    _IOFBF,     64 << 10,   1 },
+    { "aligned-1M",     _IOFBF,     1 << 20,    1 },
+};
+#define NR_BUF_MODES    (int)(sizeof(buf_modes) / sizeof(buf_modes[0]))
+
+/* Whole-mode totals, for the summary after a sweep */
+struct buf_result {
+    double sec;
+    uint64_t syscalls;
+};
+
+static struct bench_config cfg;
+
 int seq_read                (FILE *fp, char *buf);
 int seq_write               (FILE *fp, const int fd, const char *buf);
 int random_read             (FILE *fp, char *buf);
 int random_write_buffered   (FILE *fp, const int fd, const char *buf);
 int random_write_sync       (FILE *fp, const int fd, const char *buf);
+int replay                  (FILE *fp, const int fd, char *buf,
+                             const struct trace *t, struct trace_clock *clk);
+
+int run_buf_mode(char *buf, const struct buf_mode *mode, struct buf_result *res);
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-l] [-v mode] [matrix options] [-T file | -P file [-O]]\n"
+            "  -l         record per-operation latency percentiles\n"
+            "  -v mode    buffer the stream with default, none, line, 4K, 16K,\n"
+            "             64K, 256K, 1M, 4M, 16M, aligned-64K, aligned-1M or all,\n"
+            "             and report the syscalls the C library made per phase\n"
+            BENCH_MATRIX_USAGE
+            TRACE_USAGE, prog);
+}
 
-int main()
+int main(int argc, char *argv[])
 {
-    srand(time(NULL));
-    FILE *fp = fopen(FILE_NAME, "r+b");
+    struct bench_matrix matrix;
+    bench_matrix_init(&matrix);
+
+    int mode = -1;          /* index into buf_modes, NR_BUF_MODES for all */
+
+    int opt;
+    while ((opt = getopt(argc, argv, "lv:" BENCH_MATRIX_OPTS TRACE_OPTS)) != -1)
+    {
+        int handled = bench_matrix_option(&matrix, opt, optarg);
+        if (handled < 0)
+            return -1;
+        if (handled)
+            continue;
+        if (trace_option(opt, optarg))
+            continue;
+
+        switch (opt)
+        {
+        case 'l':
+            lat_enabled = 1;
+            break;
+        case 'v':
+            for (mode = 0; mode < NR_BUF_MODES; ++mode)
+                if (strcmp(optarg, buf_modes[mode].name) == 0)
+                    break;
+            if (mode == NR_BUF_MODES && strcmp(optarg, "all") != 0)
+            {
+                fprintf(stderr, "Unknown mode '%s'\n", optarg);
+                return -1;
+            }
+            sys_acct_enabled = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    if (lat_enabled)
+        lat_calibrate();
+    if (sys_acct_enabled)
+        sys_acct_calibrate();
+
+    bench_matrix_print_offsets(&matrix);
+
+    struct trace replay_trace = { 0 };
+    if (trace_replay_file && trace_load(trace_replay_file, &replay_trace) != 0)
+        return -1;
+
+    FILE *fp = fopen(matrix.file_name, "r+b");
     if (!fp)
     {
         perror("fopen");
@@ -47,23 +172,126 @@ int main()
         return -1;
     }
 
-    char *buf;
-    if (posix_memalign((void **)&buf, 4096, FILE_SIZE) != 0)
+    size_t buf_size = bench_matrix_max_file_size(&matrix);
+    char *buf = bench_buf_alloc(&matrix, buf_size);
+    if (!buf)
     {
-        perror("posix_memalign");
         fclose(fp);
         return -1;
     }
-    memset(buf, 'X', FILE_SIZE);
 
-    MEASURE_TIME("1. Sequential Read",          { seq_read(fp, buf); })
-    MEASURE_TIME("2. Sequential Write",         { seq_write(fp, fd, buf); })
-    MEASURE_TIME("3. Random Read",              { random_read(fp, buf); })
-    MEASURE_TIME("4. Random Buffered Write",    { random_write_buffered(fp, fd, buf); })
-    MEASURE_TIME("5. Random Sync Write",        { random_write_sync(fp, fd, buf); })
+    int points = bench_matrix_points(&matrix);
+    for (int i = 0; i < points; ++i)
+    {
+        bench_matrix_get(&matrix, i, &cfg);
+        if (points > 1)
+            bench_config_print(&cfg);
+        if (bench_config_check(&cfg) != 0 || bench_prepare_file(&cfg) != 0
+            || bench_offsets_generate(&cfg) != 0)
+            continue;
+
+        if (mode >= 0)
+        {
+            int first = mode == NR_BUF_MODES ? 0 : mode;
+            int last  = mode == NR_BUF_MODES ? NR_BUF_MODES - 1 : mode;
+            struct buf_result res[NR_BUF_MODES];
+            for (int m = first; m <= last; ++m)
+                if (run_buf_mode(buf, &buf_modes[m], &res[m]) != 0)
+                    res[m].sec = -1;
+
+            if (first == last)
+                continue;
+            printf("[stdio buffering summary: all five phases]\n");
+            for (int m = first; m <= last; ++m)
+                if (res[m].sec >= 0)
+                    printf("%-25s:   %.4f sec   %10llu read/write syscalls\n", buf_modes[m].name,
+                           res[m].sec, (unsigned long long)res[m].syscalls);
+            continue;
+        }
+
+        if (trace_replay_file)
+        {
+            struct trace_clock clk;
+            if (trace_check(&replay_trace, cfg.file_size) != 0)
+                continue;
+            MEASURE_TIME("Replay",                  { replay(fp, fd, buf, &replay_trace, &clk); })
+            trace_print_summary(&replay_trace, &clk);
+            continue;
+        }
+
+        MEASURE_TIME("1. Sequential Read",          { seq_read(fp, buf); })
+        MEASURE_TIME("2. Sequential Write",         { seq_write(fp, fd, buf); })
+        MEASURE_TIME("3. Random Read",              { random_read(fp, buf); })
+        MEASURE_TIME("4. Random Buffered Write",    { random_write_buffered(fp, fd, buf); })
+        MEASURE_TIME("5. Random Sync Write",        { random_write_sync(fp, fd, buf); })
+    }
+
+    if (trace_record_file)
+        trace_save(trace_record_file, &trace_out);
 
     fclose(fp);
-    free(buf);
+    bench_buf_free(&matrix, buf, buf_size);
+}
+
+/*
+ * Open a fresh stream buffered as `mode` (setvbuf() must come before the
+ * first I/O) and run the five phases through it, with the read/write
+ * syscalls behind each. The totals over all phases go to `res`.
+ */
+int run_buf_mode(char *buf, const struct buf_mode *mode, struct buf_result *res)
+{
+    printf("[stdio %s]\n", mode->name);
+
+    FILE *fp = fopen(cfg.file_name, "r+b");
+    if (!fp)
+    {
+        perror("fopen");
+        return -1;
+    }
+
+    char *vbuf = NULL;
+    if (mode->size)
+    {
+        if (mode->aligned)
+        {
+            if (posix_memalign((void **)&vbuf, 4096, mode->size) != 0)
+                vbuf = NULL;
+        }
+        else
+            vbuf = malloc(mode->size);
+        if (!vbuf)
+        {
+            perror("stream buffer");
+            fclose(fp);
+            return -1;
+        }
+    }
+
+    if (mode->type >= 0 && setvbuf(fp, vbuf, mode->type, mode->size) != 0)
+    {
+        printf("   skipped: setvbuf failed\n");
+        fclose(fp);
+        free(vbuf);
+        return -1;
+    }
+
+    int fd = fileno(fp);
+    run_sec = 0;
+    run_syscalls = 0;
+
+    MEASURE_SYSCALLS("1. Sequential Read",          { seq_read(fp, buf); })
+    MEASURE_SYSCALLS("2. Sequential Write",         { seq_write(fp, fd, buf); })
+    MEASURE_SYSCALLS("3. Random Read",              { random_read(fp, buf); })
+    MEASURE_SYSCALLS("4. Random Buffered Write",    { random_write_buffered(fp, fd, buf); })
+    MEASURE_SYSCALLS("5. Random Sync Write",        { random_write_sync(fp, fd, buf); })
+
+    /* the sums of the five phases as reported, without the report lines in between */
+    res->sec = run_sec;
+    res->syscalls = run_syscalls;
+
+    fclose(fp);
+    free(vbuf);
+    return 0;
 }
 
 int seq_read(FILE *fp, char *buf)
@@ -71,15 +299,16 @@ int seq_read(FILE *fp, char *buf)
     fseek(fp, 0, SEEK_SET);
     size_t total_read = 0;
     size_t bytes_read;
-    while ((bytes_read = fread(buf, 1, READ_CHUNK_SIZE, fp)) > 0)
+    while ((bytes_read = LAT(LAT_READ, fread(buf, 1, cfg.read_chunk, fp))) > 0)
     {
+        TRACE(TRACE_READ, total_read, bytes_read);
         buf += bytes_read;
         total_read += bytes_read;
     }
     
-    if (total_read != FILE_SIZE)
+    if (total_read != cfg.file_size)
     {
-        fprintf(stderr, "Excepted %d bytes, but only read %zu bytes.\n", FILE_SIZE, total_read);
+        fprintf(stderr, "Excepted %zu bytes, but only read %zu bytes.\n", cfg.file_size, total_read);
         return -1;
     }
 
@@ -89,20 +318,22 @@ int seq_read(FILE *fp, char *buf)
 int seq_write(FILE *fp, const int fd, const char *buf)
 {
     fseek(fp, 0, SEEK_SET);
-    int nums_write = (FILE_SIZE) / (WRITE_CHUNK_SIZE);
-    for (int i = 0; i < nums_write; ++i)
+    size_t nums_write = cfg.file_size / cfg.write_chunk;
+    for (size_t i = 0; i < nums_write; ++i)
     {
-        size_t written = fwrite(buf + i * WRITE_CHUNK_SIZE, 1, WRITE_CHUNK_SIZE, fp);
+        TRACE(TRACE_WRITE, (uint64_t)i * cfg.write_chunk, cfg.write_chunk);
+        size_t written = LAT(LAT_WRITE, fwrite(buf + i * cfg.write_chunk, 1, cfg.write_chunk, fp));
         
-        if (written != WRITE_CHUNK_SIZE)
+        if (written != cfg.write_chunk)
         {
             perror("fwrite");
             return -1;
         }
     }
-    fflush(fp);
+    TRACE(TRACE_SYNC, 0, 0);
+    LAT(LAT_FLUSH, fflush(fp));
 
-    if (fsync(fd) != 0)
+    if (LAT(LAT_SYNC, SC(SC_FSYNC, fsync(fd))) != 0)
     {
         perror("fsync");
         return -1;
@@ -112,17 +343,17 @@ int seq_write(FILE *fp, const int fd, const char *buf)
 
 int random_read(FILE *fp, char *buf)
 {
-    for (int i = 0; i < 50000; ++i)
+    for (int i = 0; i < cfg.nums_random; ++i)
     {
-        /* int ofs = (rand() % (FILE_SIZE_MB * 1024 * 1024) / 4096) * 4096; */
-        int ofs = (rand() & ((FILE_SIZE_MB << 8) - 1)) << 12;
-        if (fseek(fp, ofs, SEEK_SET))
+        off_t ofs = bench_offsets[OFS_READ][i];
+        TRACE(TRACE_READ, ofs, cfg.read_chunk);
+        if (fseeko(fp, ofs, SEEK_SET))
         {
-            perror("fseek");
+            perror("fseeko");
             return -1;
         }
 
-        if (fread(buf + ofs, 1, READ_CHUNK_SIZE, fp) != READ_CHUNK_SIZE)
+        if (LAT(LAT_READ, fread(buf + ofs, 1, cfg.read_chunk, fp)) != cfg.read_chunk)
         {
             perror("fread");
             return -1;
@@ -134,26 +365,27 @@ int random_read(FILE *fp, char *buf)
 
 int random_write_buffered(FILE *fp, const int fd, const char *buf)
 {
-    for (int i = 0; i < 50000; ++i)
+    for (int i = 0; i < cfg.nums_random; ++i)
     {
-        /* int ofs = (rand() % (FILE_SIZE_MB * 1024 * 1024) / 4096) * 4096; */
-        int ofs = (rand() & ((FILE_SIZE_MB << 8) - 1)) << 12;
-        if (fseek(fp, ofs, SEEK_SET))
+        off_t ofs = bench_offsets[OFS_WRITE][i];
+        TRACE(TRACE_WRITE, ofs, cfg.write_chunk);
+        if (fseeko(fp, ofs, SEEK_SET))
         {
-            perror("fseek");
+            perror("fseeko");
             return -1;
         }
 
-        size_t written = fwrite(buf + ofs, 1, WRITE_CHUNK_SIZE, fp);
+        size_t written = LAT(LAT_WRITE, fwrite(buf + ofs, 1, cfg.write_chunk, fp));
         
-        if (written != WRITE_CHUNK_SIZE)
+        if (written != cfg.write_chunk)
         {
             perror("fwrite");
             return -1;
         }
     }
-    fflush(fp);
-    if (fsync(fd) != 0)
+    TRACE(TRACE_SYNC, 0, 0);
+    LAT(LAT_FLUSH, fflush(fp));
+    if (LAT(LAT_SYNC, SC(SC_FSYNC, fsync(fd))) != 0)
     {
         perror("fsync");
         return -1;
@@ -163,30 +395,78 @@ int random_write_buffered(FILE *fp, const int fd, const char *buf)
 
 int random_write_sync(FILE *fp, const int fd, const char *buf)
 {
-    for (int i = 0; i < 50000; ++i)
+    for (int i = 0; i < cfg.nums_random; ++i)
     {
-        /* int ofs = (rand() % (FILE_SIZE_MB * 1024 * 1024) / 4096) * 4096; */
-        int ofs = (rand() & ((FILE_SIZE_MB << 8) - 1)) << 12;
-        if (fseek(fp, ofs, SEEK_SET))
+        off_t ofs = bench_offsets[OFS_WRITE_SYNC][i];
+        TRACE(TRACE_WRITE, ofs, cfg.write_chunk);
+        if (fseeko(fp, ofs, SEEK_SET))
         {
-            perror("fseek");
+            perror("fseeko");
             return -1;
         }
 
-        size_t written = fwrite(buf + ofs, 1, WRITE_CHUNK_SIZE, fp);
+        size_t written = LAT(LAT_WRITE, fwrite(buf + ofs, 1, cfg.write_chunk, fp));
         
-        if (written != WRITE_CHUNK_SIZE)
+        if (written != cfg.write_chunk)
         {
             perror("fwrite");
             return -1;
         }
 
-        fflush(fp);
-        if (fsync(fd) != 0)
+        TRACE(TRACE_SYNC, ofs, cfg.write_chunk);
+        LAT(LAT_FLUSH, fflush(fp));
+        if (LAT(LAT_SYNC, SC(SC_FSYNC, fsync(fd))) != 0)
         {
             perror("fsync");
             return -1;
         }
     }
     return 0;
-}
\ No newline at end of file
+}
+
+/*
+ * Replay a trace through stdio: seek + fread/fwrite per op, and a SYNC
+ * becomes fflush + fsync, like the buffered workloads above.
+ */
+int replay(FILE *fp, const int fd, char *buf,
+           const struct trace *t, struct trace_clock *clk)
+{
+    trace_clock_start(clk);
+    for (size_t i = 0; i < t->n; ++i)
+    {
+        const struct trace_rec *r = &t->recs[i];
+        trace_wait(clk, r);
+
+        if (r->op == TRACE_SYNC)
+        {
+            LAT(LAT_FLUSH, fflush(fp));
+            if (LAT(LAT_SYNC, SC(SC_FSYNC, fsync(fd))) != 0)
+            {
+                perror("fsync");
+                return -1;
+            }
+            continue;
+        }
+
+        if (fseeko(fp, r->offset, SEEK_SET))
+        {
+            perror("fseeko");
+            return -1;
+        }
+
+        if (r->op == TRACE_READ)
+        {
+            if (LAT(LAT_READ, fread(buf + r->offset, 1, r->length, fp)) != r->length)
+            {
+                perror("fread");
+                return -1;
+            }
+        }
+        else if (LAT(LAT_WRITE, fwrite(buf + r->offset, 1, r->length, fp)) != r->length)
+        {
+            perror("fwrite");
+            return -1;
+        }
+    }
+    return 0;
+}
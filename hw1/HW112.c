@@ -1,3 +1,5 @@
+#define _GNU_SOURCE
+
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -7,17 +9,21 @@
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
 
-#define FILE_NAME       "100MB.bin"
-#define FILE_SIZE_MB    100
-#define FILE_SIZE       (FILE_SIZE_MB * 1024 * 1024)
-
-#define READ_CHUNK_SIZE     4096
-#define WRITE_CHUNK_SIZE    2048
+#include "bench_config.h"
+#include "dio.h"
+#include "lat_hist.h"
+#include "trace.h"
+#include "sys_acct.h"
 
 #define MEASURE_TIME(name, code_block) do {     \
     struct timeval __tv1, __tv2;                \
+    lat_phase_begin();                          \
     gettimeofday(&__tv1, NULL);                 \
     code_block                                  \
     gettimeofday(&__tv2, NULL);                 \
@@ -25,47 +31,633 @@
         1000000 * (__tv2.tv_sec - __tv1.tv_sec) \
         + (__tv2.tv_usec - __tv1.tv_usec);      \
     printf("%-25s:   %.4f sec\n", name, __diff / 1000000.0);  \
+    lat_phase_end();                            \
 } while (0); 
 
+#define VEC_DEFAULT_BATCH   64
+#define GROUP_DEFAULT_SIZE  16
+#define GROUP_DEFAULT_WINDOW_US 1000
+
+/*
+ * MEASURE_IO plus the accounting of sys_acct.h: the calls the workloads
+ * issued through SC(), what the kernel saw and the CPU time, read outside
+ * the timed region like bench.c's MEASURE_PHASE does.
+ */
+#define MEASURE_SYSCALLS(name, bytes, ops, code_block) do {             \
+    struct timeval __tv1, __tv2;                                        \
+    lat_phase_begin();                                                  \
+    sys_acct_begin();                                                   \
+    gettimeofday(&__tv1, NULL);                                         \
+    code_block                                                          \
+    gettimeofday(&__tv2, NULL);                                         \
+    sys_acct_end();                                                     \
+    double __sec = (__tv2.tv_sec - __tv1.tv_sec)                        \
+        + (__tv2.tv_usec - __tv1.tv_usec) / 1000000.0;                  \
+    printf("%-25s:   %.4f sec   %9.2f MB/s   %9.0f IOPS\n", name, __sec, \
+           (bytes) / 1048576.0 / __sec, (ops) / __sec);                 \
+    lat_phase_end();                                                    \
+    sys_acct_print();                                                   \
+    printf("    syscalls: %llu (%.2f per op)\n",                         \
+           (unsigned long long)sys_acct_issued(),                       \
+           (double)sys_acct_issued() / (ops));                          \
+} while (0);
+
+static struct bench_config cfg;
+static int vec_batch = VEC_DEFAULT_BATCH;
+static int group_size = GROUP_DEFAULT_SIZE;
+static long group_window_us = GROUP_DEFAULT_WINDOW_US;
+
 int seq_read                (const int fd, char *buf);
 int seq_write               (const int fd, const char *buf);
 int random_read             (const int fd, char *buf);
 int random_write_buffered   (const int fd, const char *buf);
 int random_write_sync       (const int fd, const char *buf);
+int replay                  (const int fd, char *buf,
+                             const struct trace *t, struct trace_clock *clk);
+
+int seq_read_pos                (const int fd, char *buf);
+int seq_write_pos               (const int fd, const char *buf);
+int random_read_pos             (const int fd, char *buf);
+int random_write_buffered_pos   (const int fd, const char *buf);
+int random_write_sync_pos       (const int fd, const char *buf);
+
+int seq_read_vec                (const int fd, char *buf);
+int seq_write_vec               (const int fd, const char *buf);
+int random_read_vec             (const int fd, char *buf);
+int random_write_buffered_vec   (const int fd, const char *buf);
+int random_write_sync_vec       (const int fd, const char *buf);
+
+/* The five workloads implemented with one flavour of positioning syscalls */
+struct io_mode {
+    const char *name;
+    const char *desc;
+    int (*seq_read)             (const int fd, char *buf);
+    int (*seq_write)            (const int fd, const char *buf);
+    int (*random_read)          (const int fd, char *buf);
+    int (*random_write_buffered)(const int fd, const char *buf);
+    int (*random_write_sync)    (const int fd, const char *buf);
+};
+
+static const struct io_mode io_modes[] = {
+    { "lseek", "lseek + read/write",
+      seq_read, seq_write, random_read, random_write_buffered, random_write_sync },
+    { "pread", "pread/pwrite",
+      seq_read_pos, seq_write_pos, random_read_pos, random_write_buffered_pos, random_write_sync_pos },
+    { "vec",   "sorted, merged preadv/pwritev batches",
+      seq_read_vec, seq_write_vec, random_read_vec, random_write_buffered_vec, random_write_sync_vec },
+};
+#define NR_IO_MODES     (int)(sizeof(io_modes) / sizeof(io_modes[0]))
+
+/* How the random sync write phase makes each pwrite durable */
+enum sync_kind { SYNC_FSYNC, SYNC_FDATASYNC, SYNC_RANGE, SYNC_OPEN, SYNC_GROUP };
 
-int main()
+struct sync_mode {
+    const char *name;
+    const char *desc;
+    enum sync_kind kind;
+    int open_flags;         /* SYNC_OPEN: flags of the dedicated descriptor */
+};
+
+static const struct sync_mode sync_modes[] = {
+    { "fsync",     "pwrite + fsync",                                SYNC_FSYNC,     0 },
+    { "fdatasync", "pwrite + fdatasync",                            SYNC_FDATASYNC, 0 },
+    /* writes back data pages only: no metadata, no device cache flush */
+    { "sfr",       "pwrite + sync_file_range(WAIT_BEFORE|WRITE|WAIT_AFTER), not durable",
+                                                                    SYNC_RANGE,     0 },
+    { "dsync",     "pwrite on an O_DSYNC descriptor",               SYNC_OPEN,      O_DSYNC },
+    { "sync",      "pwrite on an O_SYNC descriptor",                SYNC_OPEN,      O_SYNC },
+    { "group",     "group commit, one fdatasync per batch",         SYNC_GROUP,     0 },
+};
+#define NR_SYNC_MODES   (int)(sizeof(sync_modes) / sizeof(sync_modes[0]))
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-l] [-m mode] [-b batch] [-d] [-c chunk] [-t threads] [-p]\n"
+            "          [-y mode] [-g size] [-w usec] [matrix options] [-T file | -P file [-O]]\n"
+            "  -l         record per-operation latency percentiles\n"
+            "  -m mode    lseek, pread, vec or all: report throughput, syscall\n"
+            "             counts, CPU time and context switches per phase for\n"
+            "             the chosen positioning syscalls\n"
+            "  -b batch   ops per preadv/pwritev batch in vec mode (default %d);\n"
+            "             random ops only merge when their chunk equals the offset\n"
+            "             slot, max(4K, -R, -W), so e.g. -W 4K for random writes\n"
+            "  -d         open with O_DIRECT and sweep chunk sizes %d..%d\n"
+            "  -c chunk   with -d, run a single chunk size\n"
+            "  -t threads run the pread/pwrite scaling mode, sweeping 1..threads\n"
+            "             workers (0 = number of CPUs this process may use)\n"
+            "  -p         with -t, pin worker i to the (i %% n)-th of the n CPUs\n"
+            "             in the process affinity mask\n"
+            "  -y mode    run the random sync write phase with fsync, fdatasync,\n"
+            "             dsync (O_DSYNC), sync (O_SYNC), group or all, reporting\n"
+            "             per-write commit latency; also sfr (sync_file_range),\n"
+            "             which is not durable: it flushes neither metadata nor\n"
+            "             the device write cache\n"
+            "  -g size    writes per group commit (default %d)\n"
+            "  -w usec    group commit window: flush a partial group once its\n"
+            "             oldest write waited this long (default %d)\n"
+            BENCH_MATRIX_USAGE
+            "             (-d replaces -R/-W with its own chunk sweep)\n"
+            TRACE_USAGE,
+            prog, VEC_DEFAULT_BATCH, DIO_MIN_CHUNK, DIO_MAX_CHUNK,
+            GROUP_DEFAULT_SIZE, GROUP_DEFAULT_WINDOW_US);
+}
+
+int run_modes(const int fd, char *buf, int mode);
+int run_direct(const int fd, char *buf, size_t single_chunk);
+int run_threads(const int fd, char *buf, int max_threads, int pin);
+int run_sync_modes(const int fd, const char *buf, int mode);
+
+int main(int argc, char *argv[])
 {
-    srand(time(NULL));
+    struct bench_matrix matrix;
+    bench_matrix_init(&matrix);
+
+    int direct = 0;
+    size_t single_chunk = 0;
+    int max_threads = -1;
+    int pin = 0;
+    int mode = -1;          /* index into io_modes, NR_IO_MODES for all */
+    int sync_mode = -1;     /* index into sync_modes, NR_SYNC_MODES for all */
+
+    int opt;
+    while ((opt = getopt(argc, argv, "lm:b:dc:t:py:g:w:h" BENCH_MATRIX_OPTS TRACE_OPTS)) != -1)
+    {
+        int handled = bench_matrix_option(&matrix, opt, optarg);
+        if (handled < 0)
+            return -1;
+        if (handled)
+            continue;
+        if (trace_option(opt, optarg))
+            continue;
 
-    int fd = open(FILE_NAME, O_RDWR);
+        switch (opt)
+        {
+        case 'l':
+            lat_enabled = 1;
+            break;
+        case 'm':
+            for (mode = 0; mode < NR_IO_MODES; ++mode)
+                if (strcmp(optarg, io_modes[mode].name) == 0)
+                    break;
+            if (mode == NR_IO_MODES && strcmp(optarg, "all") != 0)
+            {
+                fprintf(stderr, "Unknown mode '%s'\n", optarg);
+                return -1;
+            }
+            sys_acct_enabled = 1;
+            break;
+        case 'b':
+            vec_batch = atoi(optarg);
+            if (vec_batch < 1 || vec_batch > IOV_MAX)
+            {
+                fprintf(stderr, "Batch must be in 1..%d\n", IOV_MAX);
+                return -1;
+            }
+            break;
+        case 'd':
+            direct = 1;
+            break;
+        case 'c':
+            if (bench_parse_size(optarg, &single_chunk) != 0)
+                return -1;
+            break;
+        case 't':
+            max_threads = atoi(optarg);
+            if (max_threads <= 0)
+            {
+                cpu_set_t allowed;
+                CPU_ZERO(&allowed);
+                max_threads = sched_getaffinity(0, sizeof(allowed), &allowed) == 0
+                    ? CPU_COUNT(&allowed) : sysconf(_SC_NPROCESSORS_ONLN);
+            }
+            break;
+        case 'p':
+            pin = 1;
+            break;
+        case 'y':
+            for (sync_mode = 0; sync_mode < NR_SYNC_MODES; ++sync_mode)
+                if (strcmp(optarg, sync_modes[sync_mode].name) == 0)
+                    break;
+            if (sync_mode == NR_SYNC_MODES && strcmp(optarg, "all") != 0)
+            {
+                fprintf(stderr, "Unknown durability mode '%s'\n", optarg);
+                return -1;
+            }
+            break;
+        case 'g':
+            group_size = atoi(optarg);
+            if (group_size < 1)
+            {
+                fprintf(stderr, "Group size must be positive\n");
+                return -1;
+            }
+            break;
+        case 'w':
+            group_window_us = atol(optarg);
+            if (group_window_us < 0)
+            {
+                fprintf(stderr, "Group window must not be negative\n");
+                return -1;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    if (lat_enabled)
+        lat_calibrate();
+    if (sys_acct_enabled)
+        sys_acct_calibrate();
+
+    bench_matrix_print_offsets(&matrix);
+
+    struct trace replay_trace = { 0 };
+    if (trace_replay_file && trace_load(trace_replay_file, &replay_trace) != 0)
+        return -1;
+
+    int fd = open(matrix.file_name, O_RDWR | (direct ? O_DIRECT : 0));
     if (fd == -1)
     {
         perror("open");
         return -1;
     }
 
-    char *buf;
-    if (posix_memalign((void **)&buf, 4096, FILE_SIZE) != 0)
+    size_t buf_size = bench_matrix_max_file_size(&matrix);
+    char *buf = bench_buf_alloc(&matrix, buf_size);
+    if (!buf)
     {
-        perror("posix_memalign");
         close(fd);
         return -1;
     }
-    memset(buf, 'X', FILE_SIZE);
 
-    MEASURE_TIME("1. Sequential Read",          { seq_read(fd, buf); })
-    MEASURE_TIME("2. Sequential Write",         { seq_write(fd, buf); })
-    MEASURE_TIME("3. Random Read",              { random_read(fd, buf); })
-    MEASURE_TIME("4. Random Buffered Write",    { random_write_buffered(fd, buf); })
-    MEASURE_TIME("5. Random Sync Write",        { random_write_sync(fd, buf); })
+    int ret = 0;
+    int points = bench_matrix_points(&matrix);
+    for (int i = 0; i < points && ret == 0; ++i)
+    {
+        bench_matrix_get(&matrix, i, &cfg);
+        if (points > 1)
+            bench_config_print(&cfg);
+        if (bench_config_check(&cfg) != 0 || bench_prepare_file(&cfg) != 0
+            || bench_offsets_generate(&cfg) != 0)
+            continue;
+
+        if (trace_replay_file)
+        {
+            struct trace_clock clk;
+            if (trace_check(&replay_trace, cfg.file_size) != 0)
+                continue;
+            MEASURE_TIME("Replay",                  { ret = replay(fd, buf, &replay_trace, &clk); })
+            trace_print_summary(&replay_trace, &clk);
+            continue;
+        }
+
+        if (max_threads > 0)
+        {
+            if (direct)
+            {
+                struct dio_align align;
+                size_t chunk = single_chunk ? single_chunk : 4096;
+                if (dio_get_align(fd, &align) != 0
+                    || dio_check(&align, chunk, cfg.file_size, buf) != 0)
+                {
+                    ret = -1;
+                    break;
+                }
+                cfg.read_chunk = cfg.write_chunk = chunk;
+                if (bench_offsets_generate(&cfg) != 0)
+                {
+                    ret = -1;
+                    break;
+                }
+            }
+            ret = run_threads(fd, buf, max_threads, pin);
+            continue;
+        }
+
+        if (direct)
+        {
+            ret = run_direct(fd, buf, single_chunk);
+            continue;
+        }
+
+        if (sync_mode >= 0)
+        {
+            ret = run_sync_modes(fd, buf, sync_mode);
+            continue;
+        }
+
+        if (mode >= 0)
+        {
+            ret = run_modes(fd, buf, mode);
+            continue;
+        }
+
+        MEASURE_TIME("1. Sequential Read",          { seq_read(fd, buf); })
+        MEASURE_TIME("2. Sequential Write",         { seq_write(fd, buf); })
+        MEASURE_TIME("3. Random Read",              { random_read(fd, buf); })
+        MEASURE_TIME("4. Random Buffered Write",    { random_write_buffered(fd, buf); })
+        MEASURE_TIME("5. Random Sync Write",        { random_write_sync(fd, buf); })
+    }
+
+    if (trace_record_file)
+        trace_save(trace_record_file, &trace_out);
 
     close(fd);
-    free(buf);
+    bench_buf_free(&matrix, buf, buf_size);
+    return ret;
+}
+
+/*
+ * Run the five phases with one or all io_modes, reporting the syscalls each
+ * phase issued next to its throughput.
+ */
+int run_modes(const int fd, char *buf, int mode)
+{
+    int first = mode == NR_IO_MODES ? 0 : mode;
+    int last  = mode == NR_IO_MODES ? NR_IO_MODES - 1 : mode;
+
+    size_t seq_reads     = cfg.file_size / cfg.read_chunk;
+    size_t seq_writes    = cfg.file_size / cfg.write_chunk;
+    size_t random_reads  = (size_t)cfg.nums_random * cfg.read_chunk;
+    size_t random_writes = (size_t)cfg.nums_random * cfg.write_chunk;
+
+    for (int m = first; m <= last; ++m)
+    {
+        const struct io_mode *io = &io_modes[m];
+        if (io->seq_read == seq_read_vec)
+        {
+            printf("[%s, batch=%d]\n", io->desc, vec_batch);
+            /* random offsets sit on slot boundaries, so smaller chunks leave gaps */
+            size_t slot = bench_slot_size(&cfg);
+            if (cfg.read_chunk < slot)
+                printf("    note: %zu byte reads on %zu byte slots are never adjacent, random reads will not merge\n",
+                       cfg.read_chunk, slot);
+            if (cfg.write_chunk < slot)
+                printf("    note: %zu byte writes on %zu byte slots are never adjacent, random writes will not merge\n",
+                       cfg.write_chunk, slot);
+        }
+        else
+            printf("[%s]\n", io->desc);
+
+        MEASURE_SYSCALLS("1. Sequential Read",       cfg.file_size, seq_reads,       { io->seq_read(fd, buf); })
+        MEASURE_SYSCALLS("2. Sequential Write",      cfg.file_size, seq_writes,      { io->seq_write(fd, buf); })
+        MEASURE_SYSCALLS("3. Random Read",           random_reads,  cfg.nums_random, { io->random_read(fd, buf); })
+        MEASURE_SYSCALLS("4. Random Buffered Write", random_writes, cfg.nums_random, { io->random_write_buffered(fd, buf); })
+        MEASURE_SYSCALLS("5. Random Sync Write",     random_writes, cfg.nums_random, { io->random_write_sync(fd, buf); })
+    }
+    return 0;
+}
+
+/*
+ * Sweep chunk sizes with the page cache bypassed. Read and write chunks are
+ * set to the same size so that every phase moves whole logical blocks.
+ */
+int run_direct(const int fd, char *buf, size_t single_chunk)
+{
+    struct dio_align align;
+    if (dio_get_align(fd, &align) != 0)
+        return -1;
+
+    printf("O_DIRECT: memory alignment %zu, offset alignment %zu\n",
+           align.mem_align, align.ofs_align);
+
+    size_t file_size = cfg.file_size;
+    int base_ops = cfg.nums_random;
+    size_t first = single_chunk ? single_chunk : DIO_MIN_CHUNK;
+    size_t last  = single_chunk ? single_chunk : DIO_MAX_CHUNK;
+
+    for (size_t chunk = first; chunk <= last; chunk <<= 1)
+    {
+        printf("[O_DIRECT, chunk=%zu]\n", chunk);
+        if (dio_check(&align, chunk, file_size, buf) != 0)
+            continue;
+
+        cfg.read_chunk = cfg.write_chunk = chunk;
+        cfg.nums_random = dio_random_ops(chunk, file_size, base_ops);
+        if (bench_offsets_generate(&cfg) != 0)
+            return -1;
+        size_t random_bytes = (size_t)cfg.nums_random * chunk;
+
+        MEASURE_IO("1. Sequential Read",        file_size, file_size / chunk,       { seq_read(fd, buf); })
+        MEASURE_IO("2. Sequential Write",       file_size, file_size / chunk,       { seq_write(fd, buf); })
+        MEASURE_IO("3. Random Read",            random_bytes, cfg.nums_random,      { random_read(fd, buf); })
+        MEASURE_IO("4. Random Buffered Write",  random_bytes, cfg.nums_random,      { random_write_buffered(fd, buf); })
+        MEASURE_IO("5. Random Sync Write",      random_bytes, cfg.nums_random,      { random_write_sync(fd, buf); })
+    }
+    return 0;
+}
+
+enum mt_phase { MT_READ, MT_WRITE, MT_WRITE_SYNC };
+
+/* Start gate so worker creation stays outside the timed region */
+struct mt_gate {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int open;
+};
+
+struct mt_worker {
+    pthread_t tid;
+    struct mt_gate *gate;
+    enum mt_phase phase;
+    int fd;
+    char *buf;
+    const off_t *ofs;       /* this worker's slice of the phase's offsets */
+    int ops;
+    int ret;
+    struct lat_hist hists[LAT_NR_OPS];  /* merged into lat_hists after join */
+};
+
+static void mt_gate_open(struct mt_gate *gate)
+{
+    pthread_mutex_lock(&gate->lock);
+    gate->open = 1;
+    pthread_cond_broadcast(&gate->cond);
+    pthread_mutex_unlock(&gate->lock);
+}
+
+/*
+ * One worker of the scaling mode. pread/pwrite carry their own offset, so
+ * workers never contend on the file position the way lseek+read would.
+ */
+static void *mt_worker_main(void *arg)
+{
+    struct mt_worker *w = arg;
+
+    pthread_mutex_lock(&w->gate->lock);
+    while (!w->gate->open)
+        pthread_cond_wait(&w->gate->cond, &w->gate->lock);
+    pthread_mutex_unlock(&w->gate->lock);
+
+    for (int i = 0; i < w->ops; ++i)
+    {
+        off_t ofs = w->ofs[i];
+        if (w->phase == MT_READ)
+        {
+            if (LAT_H(&w->hists[LAT_READ], pread(w->fd, w->buf + ofs, cfg.read_chunk, ofs)) != (ssize_t)cfg.read_chunk)
+            {
+                perror("pread");
+                w->ret = -1;
+                break;
+            }
+            continue;
+        }
+
+        if (LAT_H(&w->hists[LAT_WRITE], pwrite(w->fd, w->buf + ofs, cfg.write_chunk, ofs)) != (ssize_t)cfg.write_chunk)
+        {
+            perror("pwrite");
+            w->ret = -1;
+            break;
+        }
+        if (w->phase == MT_WRITE_SYNC && LAT_H(&w->hists[LAT_SYNC], fsync(w->fd)) != 0)
+        {
+            perror("fsync");
+            w->ret = -1;
+            break;
+        }
+    }
+    return NULL;
+}
+
+/* Number of the n-th CPU set in `allowed` */
+static int mt_nth_cpu(const cpu_set_t *allowed, int n)
+{
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        if (CPU_ISSET(cpu, allowed) && n-- == 0)
+            return cpu;
+    return 0;
+}
+
+/*
+ * Run `cfg.nums_random` ops of `phase` split across `nthreads` workers, each
+ * taking a contiguous slice of the precomputed offsets and optionally pinned
+ * to one CPU.
+ */
+static int mt_run_phase(const int fd, char *buf, enum mt_phase phase,
+                        int nthreads, int pin, const char *name)
+{
+    struct mt_worker *workers = calloc(nthreads, sizeof(*workers));
+    if (!workers)
+    {
+        perror("calloc");
+        return -1;
+    }
+
+    struct mt_gate gate = {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .cond = PTHREAD_COND_INITIALIZER,
+        .open = 0,
+    };
+
+    static const enum bench_ofs phase_ofs[] = {
+        [MT_READ] = OFS_READ, [MT_WRITE] = OFS_WRITE, [MT_WRITE_SYNC] = OFS_WRITE_SYNC,
+    };
+    const off_t *ofs = bench_offsets[phase_ofs[phase]];
+
+    /* pin to the CPUs this process may use, which need not be 0..n-1 */
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (pin && sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    {
+        perror("sched_getaffinity");
+        free(workers);
+        return -1;
+    }
+    int ncpu = CPU_COUNT(&allowed);
+
+    int created = 0;
+    for (; created < nthreads; ++created)
+    {
+        struct mt_worker *w = &workers[created];
+        w->gate = &gate;
+        w->phase = phase;
+        w->fd = fd;
+        w->buf = buf;
+        w->ops = cfg.nums_random / nthreads + (created < cfg.nums_random % nthreads);
+        w->ofs = ofs;
+        ofs += w->ops;
+
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        if (pin)
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(mt_nth_cpu(&allowed, created % ncpu), &set);
+            pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+        }
+        int err = pthread_create(&w->tid, &attr, mt_worker_main, w);
+        pthread_attr_destroy(&attr);
+        if (err != 0)
+        {
+            fprintf(stderr, "pthread_create: %s\n", strerror(err));
+            break;
+        }
+    }
+
+    int ret = 0;
+    if (created != nthreads)
+    {
+        mt_gate_open(&gate);
+        for (int i = 0; i < created; ++i)
+            pthread_join(workers[i].tid, NULL);
+        free(workers);
+        return -1;
+    }
+
+    size_t chunk = phase == MT_READ ? cfg.read_chunk : cfg.write_chunk;
+    MEASURE_IO(name, (size_t)cfg.nums_random * chunk, cfg.nums_random, {
+        mt_gate_open(&gate);
+        for (int i = 0; i < nthreads; ++i)
+        {
+            pthread_join(workers[i].tid, NULL);
+            if (workers[i].ret != 0)
+                ret = -1;
+        }
+        for (int i = 0; i < nthreads; ++i)
+            for (int op = 0; op < LAT_NR_OPS; ++op)
+                lat_merge(&lat_hists[op], &workers[i].hists[op]);
+        if (phase == MT_WRITE && LAT(LAT_SYNC, fsync(fd)) != 0)
+        {
+            perror("fsync");
+            ret = -1;
+        }
+    })
+
+    free(workers);
+    return ret;
+}
+
+/*
+ * Scaling mode: random pread/pwrite from 1, 2, 4, ... workers up to
+ * `max_threads`. Every step issues the same total number of ops, so the
+ * IOPS column is directly the scaling curve.
+ */
+int run_threads(const int fd, char *buf, int max_threads, int pin)
+{
+    for (int n = 1; ; n <<= 1)
+    {
+        if (n > max_threads)
+            n = max_threads;
+
+        printf("[threads=%d, pread/pwrite%s]\n", n, pin ? ", pinned" : "");
+        if (mt_run_phase(fd, buf, MT_READ,       n, pin, "3. Random Read") != 0
+            || mt_run_phase(fd, buf, MT_WRITE,      n, pin, "4. Random Buffered Write") != 0
+            || mt_run_phase(fd, buf, MT_WRITE_SYNC, n, pin, "5. Random Sync Write") != 0)
+            return -1;
+
+        if (n == max_threads)
+            break;
+    }
+    return 0;
 }
 
 int seq_read(const int fd, char *buf)
 {
-    if (lseek(fd, 0, SEEK_SET) == -1)
+    if (SC(SC_LSEEK, lseek(fd, 0, SEEK_SET)) == -1)
     {
         perror("lseek");
         return -1;
@@ -73,15 +665,16 @@ int seq_read(const int fd, char *buf)
 
     ssize_t total_read = 0;
     ssize_t bytes_read;
-    while ((bytes_read = read(fd, buf, READ_CHUNK_SIZE)) > 0)
+    while ((bytes_read = LAT(LAT_READ, SC(SC_READ, read(fd, buf, cfg.read_chunk)))) > 0)
     {
+        TRACE(TRACE_READ, total_read, bytes_read);
         buf += bytes_read;
         total_read += bytes_read;
     }
     
-    if (total_read != FILE_SIZE)
+    if ((size_t)total_read != cfg.file_size)
     {
-        fprintf(stderr, "Excepted %d bytes, but only read %zu bytes.\n", FILE_SIZE, total_read);
+        fprintf(stderr, "Excepted %zu bytes, but only read %zd bytes.\n", cfg.file_size, total_read);
         return -1;
     }
 
@@ -90,25 +683,27 @@ int seq_read(const int fd, char *buf)
 
 int seq_write(const int fd, const char *buf)
 {
-    if (lseek(fd, 0, SEEK_SET) == -1)
+    if (SC(SC_LSEEK, lseek(fd, 0, SEEK_SET)) == -1)
     {
         perror("lseek");
         return -1;
     }
 
-    int nums_write = (FILE_SIZE) / (WRITE_CHUNK_SIZE);
-    for (int i = 0; i < nums_write; ++i)
+    size_t nums_write = cfg.file_size / cfg.write_chunk;
+    for (size_t i = 0; i < nums_write; ++i)
     {
-        ssize_t written = write(fd, buf + i * WRITE_CHUNK_SIZE, WRITE_CHUNK_SIZE);
+        TRACE(TRACE_WRITE, (uint64_t)i * cfg.write_chunk, cfg.write_chunk);
+        ssize_t written = LAT(LAT_WRITE, SC(SC_WRITE, write(fd, buf + i * cfg.write_chunk, cfg.write_chunk)));
         
-        if (written != WRITE_CHUNK_SIZE)
+        if (written != (ssize_t)cfg.write_chunk)
         {
             perror("write");
             return -1;
         }
     }
 
-    if (fsync(fd) != 0)
+    TRACE(TRACE_SYNC, 0, 0);
+    if (LAT(LAT_SYNC, SC(SC_FSYNC, fsync(fd))) != 0)
     {
         perror("fsync");
         return -1;
@@ -118,18 +713,18 @@ int seq_write(const int fd, const char *buf)
 
 int random_read(const int fd, char *buf)
 {
-    for (int i = 0; i < 50000; ++i)
+    for (int i = 0; i < cfg.nums_random; ++i)
     {
-        /* int ofs = (rand() % (FILE_SIZE_MB * 1024 * 1024) / 4096) * 4096; */
-        int ofs = (rand() & ((FILE_SIZE_MB << 8) - 1)) << 12;
+        off_t ofs = bench_offsets[OFS_READ][i];
+        TRACE(TRACE_READ, ofs, cfg.read_chunk);
 
-        if (lseek(fd, ofs, SEEK_SET) == -1)
+        if (SC(SC_LSEEK, lseek(fd, ofs, SEEK_SET)) == -1)
         {
             perror("lseek");
             return -1;
         }
 
-        if (read(fd, buf + ofs, READ_CHUNK_SIZE) != READ_CHUNK_SIZE)
+        if (LAT(LAT_READ, SC(SC_READ, read(fd, buf + ofs, cfg.read_chunk))) != (ssize_t)cfg.read_chunk)
         {
             perror("read");
             return -1;
@@ -141,54 +736,425 @@ int random_read(const int fd, char *buf)
 
 int random_write_buffered(const int fd, const char *buf)
 {
-    for (int i = 0; i < 50000; ++i)
+    for (int i = 0; i < cfg.nums_random; ++i)
     {
-        /* int ofs = (rand() % (FILE_SIZE_MB * 1024 * 1024) / 4096) * 4096; */
-        int ofs = (rand() & ((FILE_SIZE_MB << 8) - 1)) << 12;
-        if (lseek(fd, ofs, SEEK_SET) == -1)
+        off_t ofs = bench_offsets[OFS_WRITE][i];
+        TRACE(TRACE_WRITE, ofs, cfg.write_chunk);
+        if (SC(SC_LSEEK, lseek(fd, ofs, SEEK_SET)) == -1)
         {
             perror("lseek");
             return -1;
         }
 
-        ssize_t written = write(fd, buf + ofs, WRITE_CHUNK_SIZE);
+        ssize_t written = LAT(LAT_WRITE, SC(SC_WRITE, write(fd, buf + ofs, cfg.write_chunk)));
         
-        if (written != WRITE_CHUNK_SIZE)
+        if (written != (ssize_t)cfg.write_chunk)
         {
             perror("write");
             return -1;
         }
     }
 
-    fsync(fd);
+    TRACE(TRACE_SYNC, 0, 0);
+    LAT(LAT_SYNC, SC(SC_FSYNC, fsync(fd)));
     return 0;
 }
 
 int random_write_sync(const int fd, const char *buf)
 {
-    for (int i = 0; i < 50000; ++i)
+    for (int i = 0; i < cfg.nums_random; ++i)
     {
-        /* int ofs = (rand() % (FILE_SIZE_MB * 1024 * 1024) / 4096) * 4096; */
-        int ofs = (rand() & ((FILE_SIZE_MB << 8) - 1)) << 12;
-        if (lseek(fd, ofs, SEEK_SET) == -1)
+        off_t ofs = bench_offsets[OFS_WRITE_SYNC][i];
+        TRACE(TRACE_WRITE, ofs, cfg.write_chunk);
+        if (SC(SC_LSEEK, lseek(fd, ofs, SEEK_SET)) == -1)
         {
             perror("lseek");
             return -1;
         }
 
-        ssize_t written = write(fd, buf + ofs, WRITE_CHUNK_SIZE);
+        ssize_t written = LAT(LAT_WRITE, SC(SC_WRITE, write(fd, buf + ofs, cfg.write_chunk)));
         
-        if (written != WRITE_CHUNK_SIZE)
+        if (written != (ssize_t)cfg.write_chunk)
         {
             perror("write");
             return -1;
         }
 
-        if (fsync(fd) != 0)
+        TRACE(TRACE_SYNC, ofs, cfg.write_chunk);
+        if (LAT(LAT_SYNC, SC(SC_FSYNC, fsync(fd))) != 0)
         {
             perror("fsync");
             return -1;
         }
     }
     return 0;
-}
\ No newline at end of file
+}
+
+int seq_read_pos(const int fd, char *buf)
+{
+    for (size_t ofs = 0; ofs < cfg.file_size; ofs += cfg.read_chunk)
+    {
+        if (LAT(LAT_READ, SC(SC_PREAD, pread(fd, buf + ofs, cfg.read_chunk, ofs))) != (ssize_t)cfg.read_chunk)
+        {
+            perror("pread");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int seq_write_pos(const int fd, const char *buf)
+{
+    for (size_t ofs = 0; ofs < cfg.file_size; ofs += cfg.write_chunk)
+    {
+        if (LAT(LAT_WRITE, SC(SC_PWRITE, pwrite(fd, buf + ofs, cfg.write_chunk, ofs))) != (ssize_t)cfg.write_chunk)
+        {
+            perror("pwrite");
+            return -1;
+        }
+    }
+
+    if (LAT(LAT_SYNC, SC(SC_FSYNC, fsync(fd))) != 0)
+    {
+        perror("fsync");
+        return -1;
+    }
+    return 0;
+}
+
+int random_read_pos(const int fd, char *buf)
+{
+    for (int i = 0; i < cfg.nums_random; ++i)
+    {
+        off_t ofs = bench_offsets[OFS_READ][i];
+        if (LAT(LAT_READ, SC(SC_PREAD, pread(fd, buf + ofs, cfg.read_chunk, ofs))) != (ssize_t)cfg.read_chunk)
+        {
+            perror("pread");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int random_write_buffered_pos(const int fd, const char *buf)
+{
+    for (int i = 0; i < cfg.nums_random; ++i)
+    {
+        off_t ofs = bench_offsets[OFS_WRITE][i];
+        if (LAT(LAT_WRITE, SC(SC_PWRITE, pwrite(fd, buf + ofs, cfg.write_chunk, ofs))) != (ssize_t)cfg.write_chunk)
+        {
+            perror("pwrite");
+            return -1;
+        }
+    }
+
+    if (LAT(LAT_SYNC, SC(SC_FSYNC, fsync(fd))) != 0)
+    {
+        perror("fsync");
+        return -1;
+    }
+    return 0;
+}
+
+int random_write_sync_pos(const int fd, const char *buf)
+{
+    for (int i = 0; i < cfg.nums_random; ++i)
+    {
+        off_t ofs = bench_offsets[OFS_WRITE_SYNC][i];
+        if (LAT(LAT_WRITE, SC(SC_PWRITE, pwrite(fd, buf + ofs, cfg.write_chunk, ofs))) != (ssize_t)cfg.write_chunk)
+        {
+            perror("pwrite");
+            return -1;
+        }
+
+        if (LAT(LAT_SYNC, SC(SC_FSYNC, fsync(fd))) != 0)
+        {
+            perror("fsync");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Random sync writes made durable the `m` way. Commit latency runs from
+ * the start of a pwrite until the flush that covers it returns, so with
+ * group commit a write also pays for the time its group stayed open.
+ */
+static int random_write_durable(const int fd, const char *buf, const struct sync_mode *m,
+                                struct lat_hist *commit, unsigned long *flushes)
+{
+    uint64_t *pending = malloc(group_size * sizeof(*pending));
+    if (!pending)
+    {
+        perror("malloc");
+        return -1;
+    }
+
+    int n_pending = 0;
+    int ret = 0;
+    for (int i = 0; i < cfg.nums_random && ret == 0; ++i)
+    {
+        off_t ofs = bench_offsets[OFS_WRITE_SYNC][i];
+        uint64_t t0 = lat_now();
+
+        if (LAT(LAT_WRITE, pwrite(fd, buf + ofs, cfg.write_chunk, ofs)) != (ssize_t)cfg.write_chunk)
+        {
+            perror("pwrite");
+            ret = -1;
+            break;
+        }
+
+        switch (m->kind)
+        {
+        case SYNC_FSYNC:
+            ret = LAT(LAT_SYNC, fsync(fd));
+            break;
+        case SYNC_FDATASYNC:
+            ret = LAT(LAT_SYNC, fdatasync(fd));
+            break;
+        case SYNC_RANGE:
+            ret = LAT(LAT_SYNC, sync_file_range(fd, ofs, cfg.write_chunk,
+                                                SYNC_FILE_RANGE_WAIT_BEFORE
+                                                | SYNC_FILE_RANGE_WRITE
+                                                | SYNC_FILE_RANGE_WAIT_AFTER));
+            break;
+        case SYNC_OPEN:
+            break;
+        case SYNC_GROUP:
+            pending[n_pending++] = t0;
+            if (n_pending < group_size && i + 1 < cfg.nums_random
+                && lat_now() - pending[0] < (uint64_t)group_window_us * 1000)
+                continue;
+
+            ret = LAT(LAT_SYNC, fdatasync(fd));
+            if (ret != 0)
+                perror("fdatasync");
+            uint64_t done = lat_now();
+            for (int j = 0; j < n_pending; ++j)
+                lat_record(commit, done - pending[j]);
+            n_pending = 0;
+            (*flushes)++;
+            continue;
+        }
+
+        if (ret != 0)
+            perror(m->name);
+        lat_record(commit, lat_now() - t0);
+        (*flushes)++;
+    }
+
+    free(pending);
+    return ret;
+}
+
+/*
+ * Compare durability strategies on the random sync write phase: throughput
+ * against the latency each write waits before it is committed.
+ */
+int run_sync_modes(const int fd, const char *buf, int mode)
+{
+    int first = mode == NR_SYNC_MODES ? 0 : mode;
+    int last  = mode == NR_SYNC_MODES ? NR_SYNC_MODES - 1 : mode;
+    size_t random_writes = (size_t)cfg.nums_random * cfg.write_chunk;
+
+    for (int i = first; i <= last; ++i)
+    {
+        const struct sync_mode *m = &sync_modes[i];
+        if (m->kind == SYNC_GROUP)
+            printf("[%s, size=%d, window=%ldus]\n", m->desc, group_size, group_window_us);
+        else
+            printf("[%s]\n", m->desc);
+
+        int wfd = fd;
+        if (m->kind == SYNC_OPEN && (wfd = open(cfg.file_name, O_RDWR | m->open_flags)) == -1)
+        {
+            perror("open");
+            return -1;
+        }
+
+        static struct lat_hist commit;
+        memset(&commit, 0, sizeof(commit));
+        unsigned long flushes = 0;
+        int ret = 0;
+
+        MEASURE_IO("5. Random Sync Write", random_writes, cfg.nums_random, {
+            ret = random_write_durable(wfd, buf, m, &commit, &flushes);
+        })
+        if (wfd != fd)
+            close(wfd);
+        if (ret != 0)
+            return -1;
+
+        printf("    commit: avg=%9.2f p50=%9.2f p99=%9.2f max=%9.2f us, %lu flushes (%.2f writes each)\n",
+               commit.sum / (double)commit.count / 1000.0,
+               lat_percentile(&commit, 50.0) / 1000.0,
+               lat_percentile(&commit, 99.0) / 1000.0,
+               commit.max / 1000.0, flushes,
+               flushes ? (double)cfg.nums_random / flushes : 0.0);
+    }
+    return 0;
+}
+
+static int cmp_off(const void *a, const void *b)
+{
+    off_t x = *(const off_t *)a;
+    off_t y = *(const off_t *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Issue one batch of `n` chunk-sized ops at `ofs` (sorted in place). Runs of
+ * back-to-back offsets become a single preadv/pwritev; with `sync` every
+ * vectored write is followed by an fsync, so each op is still durable
+ * before the next call is made.
+ */
+static int vec_batch_io(const int fd, const char *buf, off_t *ofs, int n,
+                        size_t chunk, int write, int sync)
+{
+    struct iovec iov[IOV_MAX];
+
+    qsort(ofs, n, sizeof(*ofs), cmp_off);
+    for (int i = 0; i < n; )
+    {
+        int run = 0;
+        do
+        {
+            iov[run].iov_base = (char *)buf + ofs[i + run];
+            iov[run].iov_len = chunk;
+            run++;
+        } while (i + run < n && ofs[i + run] == ofs[i + run - 1] + (off_t)chunk);
+
+        ssize_t want = (ssize_t)(run * chunk);
+        ssize_t done = write
+            ? LAT(LAT_WRITE, SC(SC_PWRITEV, pwritev(fd, iov, run, ofs[i])))
+            : LAT(LAT_READ, SC(SC_PREADV, preadv(fd, iov, run, ofs[i])));
+        if (done != want)
+        {
+            perror(write ? "pwritev" : "preadv");
+            return -1;
+        }
+
+        if (sync && LAT(LAT_SYNC, SC(SC_FSYNC, fsync(fd))) != 0)
+        {
+            perror("fsync");
+            return -1;
+        }
+        i += run;
+    }
+    return 0;
+}
+
+static int vec_seq(const int fd, const char *buf, size_t chunk, int write)
+{
+    off_t ofs[IOV_MAX];
+    size_t total = cfg.file_size / chunk;
+
+    for (size_t done = 0; done < total; )
+    {
+        int n = total - done < (size_t)vec_batch ? (int)(total - done) : vec_batch;
+        for (int i = 0; i < n; ++i)
+            ofs[i] = (off_t)(done + i) * chunk;
+        if (vec_batch_io(fd, buf, ofs, n, chunk, write, 0) != 0)
+            return -1;
+        done += n;
+    }
+    return 0;
+}
+
+static int vec_random(const int fd, const char *buf, const off_t *offsets,
+                      size_t chunk, int write, int sync)
+{
+    off_t ofs[IOV_MAX];
+
+    for (int done = 0; done < cfg.nums_random; )
+    {
+        int n = cfg.nums_random - done < vec_batch ? cfg.nums_random - done : vec_batch;
+        memcpy(ofs, offsets + done, n * sizeof(*ofs));
+        if (vec_batch_io(fd, buf, ofs, n, chunk, write, sync) != 0)
+            return -1;
+        done += n;
+    }
+    return 0;
+}
+
+int seq_read_vec(const int fd, char *buf)
+{
+    return vec_seq(fd, buf, cfg.read_chunk, 0);
+}
+
+int seq_write_vec(const int fd, const char *buf)
+{
+    if (vec_seq(fd, buf, cfg.write_chunk, 1) != 0)
+        return -1;
+
+    if (LAT(LAT_SYNC, SC(SC_FSYNC, fsync(fd))) != 0)
+    {
+        perror("fsync");
+        return -1;
+    }
+    return 0;
+}
+
+int random_read_vec(const int fd, char *buf)
+{
+    return vec_random(fd, buf, bench_offsets[OFS_READ], cfg.read_chunk, 0, 0);
+}
+
+int random_write_buffered_vec(const int fd, const char *buf)
+{
+    if (vec_random(fd, buf, bench_offsets[OFS_WRITE], cfg.write_chunk, 1, 0) != 0)
+        return -1;
+
+    if (LAT(LAT_SYNC, SC(SC_FSYNC, fsync(fd))) != 0)
+    {
+        perror("fsync");
+        return -1;
+    }
+    return 0;
+}
+
+int random_write_sync_vec(const int fd, const char *buf)
+{
+    return vec_random(fd, buf, bench_offsets[OFS_WRITE_SYNC], cfg.write_chunk, 1, 1);
+}
+
+/*
+ * Replay a trace with pread/pwrite, so the replay itself does not pay for
+ * the lseek the recorded workload may have issued. A SYNC is an fsync.
+ */
+int replay(const int fd, char *buf, const struct trace *t, struct trace_clock *clk)
+{
+    trace_clock_start(clk);
+    for (size_t i = 0; i < t->n; ++i)
+    {
+        const struct trace_rec *r = &t->recs[i];
+        trace_wait(clk, r);
+
+        switch (r->op)
+        {
+        case TRACE_READ:
+            if (LAT(LAT_READ, pread(fd, buf + r->offset, r->length, r->offset)) != (ssize_t)r->length)
+            {
+                perror("pread");
+                return -1;
+            }
+            break;
+        case TRACE_WRITE:
+            if (LAT(LAT_WRITE, pwrite(fd, buf + r->offset, r->length, r->offset)) != (ssize_t)r->length)
+            {
+                perror("pwrite");
+                return -1;
+            }
+            break;
+        case TRACE_SYNC:
+            if (LAT(LAT_SYNC, fsync(fd)) != 0)
+            {
+                perror("fsync");
+                return -1;
+            }
+            break;
+        }
+    }
+    return 0;
+}
@@ -1,25 +1,31 @@
+#define _GNU_SOURCE
+
 #include <unistd.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <time.h>
 
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#include <sys/resource.h>
 #include <fcntl.h>
 
-#define FILE_NAME       "100MB.bin"
-#define FILE_SIZE_MB    100
-#define FILE_SIZE       (FILE_SIZE_MB * 1024 * 1024)
+#include "bench_config.h"
+#include "lat_hist.h"
+#include "trace.h"
+#include "perf_ctr.h"
 
-#define READ_CHUNK_SIZE     4096
-#define WRITE_CHUNK_SIZE    2048
+#define BATCH_DEFAULT_PAGES     64
+#define BATCH_DEFAULT_WINDOW_US 1000
 
 #define MEASURE_TIME(name, code_block) do {     \
     struct timeval __tv1, __tv2;                \
+    lat_phase_begin();                          \
     gettimeofday(&__tv1, NULL);                 \
     code_block                                  \
     gettimeofday(&__tv2, NULL);                 \
@@ -27,73 +33,331 @@
         1000000 * (__tv2.tv_sec - __tv1.tv_sec) \
         + (__tv2.tv_usec - __tv1.tv_usec);      \
     printf("%-25s:   %.4f sec\n", name, __diff / 1000000.0);  \
+    lat_phase_end();                            \
 } while (0); 
 
+/* MEASURE_TIME plus the page faults the phase took, from getrusage() */
+#define MEASURE_FAULTS(name, code_block) do {                           \
+    struct rusage __ru1, __ru2;                                         \
+    getrusage(RUSAGE_SELF, &__ru1);                                     \
+    MEASURE_TIME(name, code_block)                                      \
+    getrusage(RUSAGE_SELF, &__ru2);                                     \
+    printf("    faults: minor %ld, major %ld\n",                        \
+           __ru2.ru_minflt - __ru1.ru_minflt,                           \
+           __ru2.ru_majflt - __ru1.ru_majflt);                          \
+} while (0);
+
+/* MEASURE_TIME plus the CPU counters of the phase (-p), dTLB misses per KB of `bytes` */
+#define MEASURE_PERF(name, bytes, code_block) do {                      \
+    MEASURE_TIME(name, { perf_phase_begin(); code_block perf_phase_end(); }) \
+    perf_phase_print(bytes);                                            \
+} while (0);
+
+/* How the file is mapped: extra mmap() flags and an madvise() hint */
+struct map_mode {
+    const char *name;
+    int flags;
+    int advice;             /* -1 for none */
+};
+
+static const struct map_mode map_modes[] = {
+    { "plain",      0,              -1 },
+    { "populate",   MAP_POPULATE,   -1 },
+    { "sequential", 0,              MADV_SEQUENTIAL },
+    { "random",     0,              MADV_RANDOM },
+    { "willneed",   0,              MADV_WILLNEED },
+#ifdef MADV_HUGEPAGE
+    { "hugepage",   0,              MADV_HUGEPAGE },
+#endif
+#ifdef MAP_HUGETLB
+    { "hugetlb",    MAP_HUGETLB,    -1 },
+#endif
+};
+#define NR_MAP_MODES    (int)(sizeof(map_modes) / sizeof(map_modes[0]))
+
+/* How the random write phases make their stores durable */
+enum sync_kind { SYNC_PAGE, SYNC_DIRTY_MSYNC, SYNC_DIRTY_RANGE };
+
+struct sync_mode {
+    const char *name;
+    const char *desc;
+    enum sync_kind kind;
+};
+
+static const struct sync_mode sync_modes[] = {
+    { "page",  "msync per write, of the whole map for buffered writes", SYNC_PAGE },
+    { "msync", "dirty page bitmap, msync per coalesced run",            SYNC_DIRTY_MSYNC },
+    { "sfr",   "dirty page bitmap, sync_file_range per coalesced run",  SYNC_DIRTY_RANGE },
+};
+#define NR_SYNC_MODES   (int)(sizeof(sync_modes) / sizeof(sync_modes[0]))
+
+/*
+ * Pages of the mapping stored to since the last commit, one bit each, set
+ * by the write path. A commit flushes runs of consecutive dirty pages with
+ * one call each instead of a call per write or one over the whole map.
+ */
+struct dirty_map {
+    uint64_t *bits;
+    size_t npages;
+    size_t ndirty;          /* pages set since the last commit */
+    unsigned long commits;
+    unsigned long runs;     /* msync/sync_file_range calls */
+    unsigned long pages;    /* flushed, over all commits */
+};
+
+static struct bench_config cfg;
+static int batch_pages = BATCH_DEFAULT_PAGES;
+static long batch_window_us = BATCH_DEFAULT_WINDOW_US;
+
 int seq_read                (char *map, char *buf);
 int seq_write               (int fd, char *map, const char *buf);
 int random_read             (char *map, char *buf);
 int random_write_buffered   (const int fd, char *map, const char *buf);
 int random_write_sync       (const int fd, char *map, const char *buf);
+int replay                  (char *map, char *buf,
+                             const struct trace *t, struct trace_clock *clk);
 
-int main()
+static void usage(const char *prog)
 {
-    srand(time(NULL));
+    fprintf(stderr,
+            "Usage: %s [-l] [-p] [-m mode] [-y mode] [-g pages] [-w usec]\n"
+            "          [matrix options] [-T file | -P file [-O]]\n"
+            "  -l         record per-operation latency percentiles\n"
+            "  -p         count cycles, instructions, LLC/dTLB misses and page\n"
+            "             faults per phase, e.g. to compare -H 4k and thp\n"
+            "  -m mode    map with plain, populate, sequential, random, willneed,\n"
+            "             hugepage, hugetlb or all, and report page faults per phase\n"
+            "  -y mode    run the random write phases with page (msync per write),\n"
+            "             msync or sfr (dirty page bitmap, flushed in coalesced runs\n"
+            "             per batch) or all, reporting pages flushed per commit\n"
+            "  -g pages   dirty pages per commit (default %d)\n"
+            "  -w usec    commit a partial batch once its oldest write waited\n"
+            "             this long (default %d)\n"
+            BENCH_MATRIX_USAGE
+            TRACE_USAGE, prog, BATCH_DEFAULT_PAGES, BATCH_DEFAULT_WINDOW_US);
+}
+
+int run_map_mode(const int fd, char *buf, const struct map_mode *mode);
+int run_sync_modes(const int fd, char *buf, int mode);
+
+int main(int argc, char *argv[])
+{
+    struct bench_matrix matrix;
+    bench_matrix_init(&matrix);
+
+    int mode = -1;          /* index into map_modes, NR_MAP_MODES for all */
+    int sync_mode = -1;     /* index into sync_modes, NR_SYNC_MODES for all */
 
-    int fd = open(FILE_NAME, O_RDWR);
+    int opt;
+    while ((opt = getopt(argc, argv, "lpm:y:g:w:" BENCH_MATRIX_OPTS TRACE_OPTS)) != -1)
+    {
+        int handled = bench_matrix_option(&matrix, opt, optarg);
+        if (handled < 0)
+            return -1;
+        if (handled)
+            continue;
+        if (trace_option(opt, optarg))
+            continue;
+
+        switch (opt)
+        {
+        case 'l':
+            lat_enabled = 1;
+            break;
+        case 'p':
+            perf_enabled = 1;
+            break;
+        case 'm':
+            for (mode = 0; mode < NR_MAP_MODES; ++mode)
+                if (strcmp(optarg, map_modes[mode].name) == 0)
+                    break;
+            if (mode == NR_MAP_MODES && strcmp(optarg, "all") != 0)
+            {
+                fprintf(stderr, "Unknown mode '%s'\n", optarg);
+                return -1;
+            }
+            break;
+        case 'y':
+            for (sync_mode = 0; sync_mode < NR_SYNC_MODES; ++sync_mode)
+                if (strcmp(optarg, sync_modes[sync_mode].name) == 0)
+                    break;
+            if (sync_mode == NR_SYNC_MODES && strcmp(optarg, "all") != 0)
+            {
+                fprintf(stderr, "Unknown durability mode '%s'\n", optarg);
+                return -1;
+            }
+            break;
+        case 'g':
+            batch_pages = atoi(optarg);
+            if (batch_pages < 1)
+            {
+                fprintf(stderr, "Batch size must be positive\n");
+                return -1;
+            }
+            break;
+        case 'w':
+            batch_window_us = atol(optarg);
+            if (batch_window_us < 0)
+            {
+                fprintf(stderr, "Batch window must not be negative\n");
+                return -1;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    if (lat_enabled)
+        lat_calibrate();
+    if (perf_enabled)
+        perf_init();
+
+    bench_matrix_print_offsets(&matrix);
+
+    struct trace replay_trace = { 0 };
+    if (trace_replay_file && trace_load(trace_replay_file, &replay_trace) != 0)
+        return -1;
+
+    int fd = open(matrix.file_name, O_RDWR);
     if (fd == -1)
     {
         perror("open");
         return -1;
     }
 
-    if (ftruncate(fd, FILE_SIZE) != 0)
+    size_t buf_size = bench_matrix_max_file_size(&matrix);
+    char *buf = bench_buf_alloc(&matrix, buf_size);
+    if (!buf)
     {
-        perror("ftruncate");
         close(fd);
         return -1;
     }
 
-    char *map = mmap(NULL, FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int points = bench_matrix_points(&matrix);
+    for (int i = 0; i < points; ++i)
+    {
+        bench_matrix_get(&matrix, i, &cfg);
+        if (points > 1)
+            bench_config_print(&cfg);
+        if (bench_config_check(&cfg) != 0 || bench_prepare_file(&cfg) != 0
+            || bench_offsets_generate(&cfg) != 0)
+            continue;
+
+        if (mode >= 0)
+        {
+            int first = mode == NR_MAP_MODES ? 0 : mode;
+            int last  = mode == NR_MAP_MODES ? NR_MAP_MODES - 1 : mode;
+            for (int m = first; m <= last; ++m)
+                run_map_mode(fd, buf, &map_modes[m]);
+            continue;
+        }
+        if (sync_mode >= 0)
+        {
+            run_sync_modes(fd, buf, sync_mode);
+            continue;
+        }
+
+        char *map = mmap(NULL, cfg.file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED)
+        {
+            perror("mmap");
+            break;
+        }
+        huge_advise_map(map, cfg.file_size, cfg.huge);
+
+        if (trace_replay_file)
+        {
+            struct trace_clock clk;
+            if (trace_check(&replay_trace, cfg.file_size) == 0)
+            {
+                MEASURE_TIME("Replay",              { replay(map, buf, &replay_trace, &clk); })
+                trace_print_summary(&replay_trace, &clk);
+            }
+            munmap(map, cfg.file_size);
+            continue;
+        }
+
+        uint64_t random_reads  = (uint64_t)cfg.nums_random * cfg.read_chunk;
+        uint64_t random_writes = (uint64_t)cfg.nums_random * cfg.write_chunk;
+
+        MEASURE_PERF("1. Sequential Read",          cfg.file_size, { seq_read(map, buf); })
+        MEASURE_PERF("2. Sequential Write",         cfg.file_size, { seq_write(fd, map, buf); })
+        MEASURE_PERF("3. Random Read",              random_reads,  { random_read(map, buf); })
+        MEASURE_PERF("4. Random Buffered Write",    random_writes, { random_write_buffered(fd, map, buf); })
+        MEASURE_PERF("5. Random Sync Write",        random_writes, { random_write_sync(fd, map, buf); })
+        if (cfg.huge != HUGE_NONE)
+            huge_report("mapping", map, cfg.file_size);
+
+        msync(map, cfg.file_size, MS_SYNC);
+        munmap(map, cfg.file_size);
+    }
+
+    if (trace_record_file)
+        trace_save(trace_record_file, &trace_out);
+
+    close(fd);
+    bench_buf_free(&matrix, buf, buf_size);
+}
+
+/*
+ * Map the file with `mode` and run the five phases, printing the page
+ * faults each one took. Mapping (and MAP_POPULATE prefaulting) is timed
+ * separately so its cost is not hidden.
+ */
+int run_map_mode(const int fd, char *buf, const struct map_mode *mode)
+{
+    printf("[mmap %s]\n", mode->name);
+
+    char *map = MAP_FAILED;
+    int err = 0;
+    MEASURE_FAULTS("0. Map",                        {
+        map = mmap(NULL, cfg.file_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | mode->flags, fd, 0);
+        if (map == MAP_FAILED)
+            err = errno;
+        else if (mode->advice >= 0 && madvise(map, cfg.file_size, mode->advice) != 0)
+            err = errno;
+    })
+
     if (map == MAP_FAILED)
     {
-        perror("mmap");
-        close(fd);
+        /* MAP_HUGETLB only works for files on hugetlbfs */
+        printf("   skipped: mmap: %s\n", strerror(err));
         return -1;
     }
-
-    char *buf;
-    if (posix_memalign((void **)&buf, 4096, FILE_SIZE) != 0)
+    if (err)
     {
-        perror("posix_memalign");
-        close(fd);
+        printf("   skipped: madvise: %s\n", strerror(err));
+        munmap(map, cfg.file_size);
         return -1;
     }
-    memset(buf, 'X', FILE_SIZE);
 
-    MEASURE_TIME("1. Sequential Read",          { seq_read(map, buf); })
-    MEASURE_TIME("2. Sequential Write",         { seq_write(fd, map, buf); })
-    MEASURE_TIME("3. Random Read",              { random_read(map, buf); })
-    MEASURE_TIME("4. Random Buffered Write",    { random_write_buffered(fd, map, buf); })
-    MEASURE_TIME("5. Random Sync Write",        { random_write_sync(fd, map, buf); })
+    MEASURE_FAULTS("1. Sequential Read",          { seq_read(map, buf); })
+    MEASURE_FAULTS("2. Sequential Write",         { seq_write(fd, map, buf); })
+    MEASURE_FAULTS("3. Random Read",              { random_read(map, buf); })
+    MEASURE_FAULTS("4. Random Buffered Write",    { random_write_buffered(fd, map, buf); })
+    MEASURE_FAULTS("5. Random Sync Write",        { random_write_sync(fd, map, buf); })
 
-    msync(map, FILE_SIZE, MS_SYNC);
-    munmap(map, FILE_SIZE);
-    close(fd);
-    free(buf);
+    msync(map, cfg.file_size, MS_SYNC);
+    munmap(map, cfg.file_size);
+    return 0;
 }
 
 int seq_read(char *map, char *buf)
 {
     size_t total_read = 0;
-    for (size_t i = 0; i < FILE_SIZE; i += READ_CHUNK_SIZE)
+    for (size_t i = 0; i < cfg.file_size; i += cfg.read_chunk)
     {
-        memcpy(buf + i, map + i, READ_CHUNK_SIZE);
-        total_read += READ_CHUNK_SIZE;
+        TRACE(TRACE_READ, i, cfg.read_chunk);
+        LAT(LAT_READ, memcpy(buf + i, map + i, cfg.read_chunk));
+        total_read += cfg.read_chunk;
     }
     
-    if (total_read != FILE_SIZE)
+    if (total_read != cfg.file_size)
     {
-        fprintf(stderr, "Excepted %d bytes, but only read %zu bytes.\n", FILE_SIZE, total_read);
+        fprintf(stderr, "Excepted %zu bytes, but only read %zu bytes.\n", cfg.file_size, total_read);
         return -1;
     }
 
@@ -102,18 +366,20 @@ int seq_read(char *map, char *buf)
 
 int seq_write(const int fd, char *map, const char *buf)
 {
-    for (size_t i = 0; i < FILE_SIZE; i += WRITE_CHUNK_SIZE)
+    for (size_t i = 0; i < cfg.file_size; i += cfg.write_chunk)
     {
-        memcpy(map + i, buf + i, WRITE_CHUNK_SIZE);
+        TRACE(TRACE_WRITE, i, cfg.write_chunk);
+        LAT(LAT_WRITE, memcpy(map + i, buf + i, cfg.write_chunk));
     }
     
-    if (msync(map, FILE_SIZE, MS_SYNC) != 0)
+    TRACE(TRACE_SYNC, 0, 0);
+    if (LAT(LAT_SYNC, msync(map, cfg.file_size, MS_SYNC)) != 0)
     {
         perror("msync");
         return -1;
     }
 
-    if (fsync(fd) != 0)
+    if (LAT(LAT_SYNC, fsync(fd)) != 0)
     {
         perror("fsync");
         return -1;
@@ -123,31 +389,32 @@ int seq_write(const int fd, char *map, const char *buf)
 
 int random_read(char *map, char *buf)
 {
-    for (int i = 0; i < 50000; ++i)
+    for (int i = 0; i < cfg.nums_random; ++i)
     {
-        /* int ofs = (rand() % (FILE_SIZE_MB * 1024 * 1024) / 4096) * 4096; */
-        int ofs = (rand() & ((FILE_SIZE_MB << 8) - 1)) << 12;
-        memcpy(buf + ofs, map + ofs, READ_CHUNK_SIZE);
+        off_t ofs = bench_offsets[OFS_READ][i];
+        TRACE(TRACE_READ, ofs, cfg.read_chunk);
+        LAT(LAT_READ, memcpy(buf + ofs, map + ofs, cfg.read_chunk));
     }
     return 0;
 }
 
 int random_write_buffered(const int fd, char *map, const char *buf)
 {
-    for (int i = 0; i < 50000; ++i)
+    for (int i = 0; i < cfg.nums_random; ++i)
     {
-        /* int ofs = (rand() % (FILE_SIZE_MB * 1024 * 1024) / 4096) * 4096; */
-        int ofs = (rand() & ((FILE_SIZE_MB << 8) - 1)) << 12;
-        memcpy(map + ofs, buf + ofs, WRITE_CHUNK_SIZE);
+        off_t ofs = bench_offsets[OFS_WRITE][i];
+        TRACE(TRACE_WRITE, ofs, cfg.write_chunk);
+        LAT(LAT_WRITE, memcpy(map + ofs, buf + ofs, cfg.write_chunk));
     }
 
-    if (msync(map, FILE_SIZE, MS_SYNC) != 0)
+    TRACE(TRACE_SYNC, 0, 0);
+    if (LAT(LAT_SYNC, msync(map, cfg.file_size, MS_SYNC)) != 0)
     {
         perror("msync");
         return -1;
     }
 
-    if (fsync(fd) != 0)
+    if (LAT(LAT_SYNC, fsync(fd)) != 0)
     {
         perror("fsync");
         return -1;
@@ -159,15 +426,16 @@ int random_write_sync(const int fd, char *map, const char *buf)
 {
     long page_size = getpagesize();
 
-    for (int i = 0; i < 50000; ++i)
+    for (int i = 0; i < cfg.nums_random; ++i)
     {
-        /* int ofs = (rand() % (FILE_SIZE_MB * 1024 * 1024) / 4096) * 4096; */
-        int ofs = (rand() & ((FILE_SIZE_MB << 8) - 1)) << 12;
-        memcpy(map + ofs, buf + ofs, WRITE_CHUNK_SIZE);
+        off_t ofs = bench_offsets[OFS_WRITE_SYNC][i];
+        TRACE(TRACE_WRITE, ofs, cfg.write_chunk);
+        LAT(LAT_WRITE, memcpy(map + ofs, buf + ofs, cfg.write_chunk));
+        TRACE(TRACE_SYNC, ofs, cfg.write_chunk);
 
         char *sync_start = (char *)((uintptr_t)(map + ofs) & ~(page_size - 1));
         
-        if (msync(sync_start, WRITE_CHUNK_SIZE, MS_SYNC) != 0)
+        if (LAT(LAT_SYNC, msync(sync_start, cfg.write_chunk, MS_SYNC)) != 0)
         {
             perror("msync");
             return -1;
@@ -175,3 +443,260 @@ int random_write_sync(const int fd, char *map, const char *buf)
     }
     return 0;
 }
+
+static inline int dirty_test(const struct dirty_map *d, size_t page)
+{
+    return d->bits[page / 64] >> (page % 64) & 1;
+}
+
+/* Record a store to [ofs, ofs + len) of the mapping */
+static inline void dirty_mark(struct dirty_map *d, off_t ofs, size_t len)
+{
+    long page_size = getpagesize();
+    for (size_t p = ofs / page_size; p <= (ofs + len - 1) / page_size; ++p)
+    {
+        if (dirty_test(d, p))
+            continue;
+        d->bits[p / 64] |= 1ull << (p % 64);
+        d->ndirty++;
+    }
+}
+
+/* Flush every run of consecutive dirty pages with one call, and clear them */
+static int dirty_commit(struct dirty_map *d, const int fd, char *map, enum sync_kind kind)
+{
+    long page_size = getpagesize();
+
+    for (size_t p = 0; p < d->npages; )
+    {
+        if (p % 64 == 0 && d->bits[p / 64] == 0)
+        {
+            p += 64;
+            continue;
+        }
+        if (!dirty_test(d, p))
+        {
+            p++;
+            continue;
+        }
+
+        size_t start = p;
+        while (p < d->npages && dirty_test(d, p))
+        {
+            d->bits[p / 64] &= ~(1ull << (p % 64));
+            p++;
+        }
+
+        off_t ofs = (off_t)start * page_size;
+        size_t len = (p - start) * page_size;
+        /* one record per run, so a replay flushes what was flushed here; 0 is the whole file */
+        TRACE(TRACE_SYNC, ofs, len > UINT32_MAX ? 0 : len);
+        int ret = kind == SYNC_DIRTY_RANGE
+            ? sync_file_range(fd, ofs, len, SYNC_FILE_RANGE_WAIT_BEFORE
+                              | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER)
+            : msync(map + ofs, len, MS_SYNC);
+        if (ret != 0)
+        {
+            perror(kind == SYNC_DIRTY_RANGE ? "sync_file_range" : "msync");
+            return -1;
+        }
+        d->runs++;
+    }
+
+    d->commits++;
+    d->pages += d->ndirty;
+    d->ndirty = 0;
+    return 0;
+}
+
+/*
+ * A random write phase made durable the `m` way: with `sync` (phase 5)
+ * commits follow every write in page mode, or every batch_pages dirty
+ * pages or batch_window_us; otherwise (phase 4) there is one commit at the
+ * end, followed by an fsync. Commit latency runs from the start of a write
+ * until the commit that covers it returns.
+ */
+static int random_write_commit(const int fd, char *map, const char *buf, const struct sync_mode *m,
+                               int sync, struct dirty_map *d, struct lat_hist *commit)
+{
+    long page_size = getpagesize();
+    const off_t *offsets = bench_offsets[sync ? OFS_WRITE_SYNC : OFS_WRITE];
+
+    uint64_t *pending = malloc(cfg.nums_random * sizeof(*pending));
+    if (!pending)
+    {
+        perror("malloc");
+        return -1;
+    }
+
+    int n_pending = 0;
+    int ret = 0;
+    for (int i = 0; i < cfg.nums_random && ret == 0; ++i)
+    {
+        off_t ofs = offsets[i];
+        pending[n_pending++] = lat_now();
+        TRACE(TRACE_WRITE, ofs, cfg.write_chunk);
+        LAT(LAT_WRITE, memcpy(map + ofs, buf + ofs, cfg.write_chunk));
+
+        if (m->kind != SYNC_PAGE)
+            dirty_mark(d, ofs, cfg.write_chunk);
+        if (!sync)
+            continue;
+        if (m->kind != SYNC_PAGE && d->ndirty < (size_t)batch_pages && i + 1 < cfg.nums_random
+            && lat_now() - pending[0] < (uint64_t)batch_window_us * 1000)
+            continue;
+
+        if (m->kind == SYNC_PAGE)
+        {
+            TRACE(TRACE_SYNC, ofs, cfg.write_chunk);
+            char *start = (char *)((uintptr_t)(map + ofs) & ~(page_size - 1));
+            size_t len = map + ofs + cfg.write_chunk - start;
+            ret = LAT(LAT_SYNC, msync(start, len, MS_SYNC));
+            if (ret != 0)
+                perror("msync");
+            d->commits++;
+            d->runs++;
+            d->pages += (len + page_size - 1) / page_size;
+        }
+        else
+            ret = LAT(LAT_SYNC, dirty_commit(d, fd, map, m->kind));
+
+        uint64_t done = lat_now();
+        for (int j = 0; j < n_pending; ++j)
+            lat_record(commit, done - pending[j]);
+        n_pending = 0;
+    }
+
+    if (!sync && ret == 0)
+    {
+        if (m->kind == SYNC_PAGE)
+        {
+            TRACE(TRACE_SYNC, 0, 0);
+            ret = LAT(LAT_SYNC, msync(map, cfg.file_size, MS_SYNC));
+            if (ret != 0)
+                perror("msync");
+            d->commits++;
+            d->runs++;
+            d->pages += d->npages;
+        }
+        else
+            ret = LAT(LAT_SYNC, dirty_commit(d, fd, map, m->kind));
+
+        if (ret == 0 && (ret = LAT(LAT_SYNC, fsync(fd))) != 0)
+            perror("fsync");
+
+        uint64_t done = lat_now();
+        for (int j = 0; j < n_pending; ++j)
+            lat_record(commit, done - pending[j]);
+    }
+
+    free(pending);
+    return ret;
+}
+
+/*
+ * Compare ways of committing the random writes to the mapping: throughput
+ * against the pages each commit flushes and the latency until a write is
+ * durable.
+ */
+int run_sync_modes(const int fd, char *buf, int mode)
+{
+    int first = mode == NR_SYNC_MODES ? 0 : mode;
+    int last  = mode == NR_SYNC_MODES ? NR_SYNC_MODES - 1 : mode;
+    uint64_t random_writes = (uint64_t)cfg.nums_random * cfg.write_chunk;
+
+    char *map = mmap(NULL, cfg.file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        perror("mmap");
+        return -1;
+    }
+    huge_advise_map(map, cfg.file_size, cfg.huge);
+
+    struct dirty_map d;
+    d.npages = (cfg.file_size + getpagesize() - 1) / getpagesize();
+    d.bits = calloc((d.npages + 63) / 64, sizeof(*d.bits));
+    if (!d.bits)
+    {
+        perror("calloc");
+        munmap(map, cfg.file_size);
+        return -1;
+    }
+
+    int ret = 0;
+    for (int i = first; i <= last && ret == 0; ++i)
+    {
+        const struct sync_mode *m = &sync_modes[i];
+        if (m->kind == SYNC_PAGE)
+            printf("[%s]\n", m->desc);
+        else
+            printf("[%s, batch=%d pages, window=%ldus]\n", m->desc, batch_pages, batch_window_us);
+
+        for (int sync = 0; sync <= 1 && ret == 0; ++sync)
+        {
+            static struct lat_hist commit;
+            memset(&commit, 0, sizeof(commit));
+            d.ndirty = d.commits = d.runs = d.pages = 0;
+
+            MEASURE_PERF(sync ? "5. Random Sync Write" : "4. Random Buffered Write", random_writes, {
+                ret = random_write_commit(fd, map, buf, m, sync, &d, &commit);
+            })
+
+            printf("    commit: avg=%9.2f p50=%9.2f p99=%9.2f max=%9.2f us, %lu commits "
+                   "of %.1f pages in %.1f runs\n",
+                   commit.count ? commit.sum / (double)commit.count / 1000.0 : 0.0,
+                   lat_percentile(&commit, 50.0) / 1000.0,
+                   lat_percentile(&commit, 99.0) / 1000.0,
+                   commit.max / 1000.0, d.commits,
+                   d.commits ? (double)d.pages / d.commits : 0.0,
+                   d.commits ? (double)d.runs / d.commits : 0.0);
+        }
+    }
+
+    free(d.bits);
+    munmap(map, cfg.file_size);
+    return ret;
+}
+
+/*
+ * Replay a trace against the mapping: reads and writes are memcpy, a SYNC
+ * msyncs the pages it covers, or the whole mapping when it has no length.
+ */
+int replay(char *map, char *buf, const struct trace *t, struct trace_clock *clk)
+{
+    long page_size = getpagesize();
+
+    trace_clock_start(clk);
+    for (size_t i = 0; i < t->n; ++i)
+    {
+        const struct trace_rec *r = &t->recs[i];
+        trace_wait(clk, r);
+
+        switch (r->op)
+        {
+        case TRACE_READ:
+            LAT(LAT_READ, memcpy(buf + r->offset, map + r->offset, r->length));
+            break;
+        case TRACE_WRITE:
+            LAT(LAT_WRITE, memcpy(map + r->offset, buf + r->offset, r->length));
+            break;
+        case TRACE_SYNC:
+        {
+            char *start = map;
+            size_t len = cfg.file_size;
+            if (r->length)
+            {
+                start = (char *)((uintptr_t)(map + r->offset) & ~(page_size - 1));
+                len = map + r->offset + r->length - start;
+            }
+            if (LAT(LAT_SYNC, msync(start, len, MS_SYNC)) != 0)
+            {
+                perror("msync");
+                return -1;
+            }
+            break;
+        }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,281 @@
+#define _GNU_SOURCE
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+
+#include "bench_config.h"
+#include "dio.h"
+#include "uring.h"
+
+#define MAX_QUEUE_DEPTH     256
+
+#define MEASURE_TIME(name, code_block) do {     \
+    struct timeval __tv1, __tv2;                \
+    gettimeofday(&__tv1, NULL);                 \
+    code_block                                  \
+    gettimeofday(&__tv2, NULL);                 \
+    unsigned long __diff =                      \
+        1000000 * (__tv2.tv_sec - __tv1.tv_sec) \
+        + (__tv2.tv_usec - __tv1.tv_usec);      \
+    printf("%-25s:   %.4f sec\n", name, __diff / 1000000.0);  \
+} while (0);
+
+static struct bench_config cfg;
+
+int seq_read                (struct uring *ring, int qd, char *buf);
+int seq_write               (struct uring *ring, int qd, const char *buf);
+int random_read             (struct uring *ring, int qd, char *buf);
+int random_write_buffered   (struct uring *ring, int qd, const char *buf);
+int random_write_sync       (struct uring *ring, int qd, const char *buf);
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-q depth] [-r] [-f] [-d] [-c chunk] [matrix options]\n"
+            "  -q depth   run a single queue depth (default: sweep 1..%d)\n"
+            "  -r         use registered buffers (READ_FIXED / WRITE_FIXED)\n"
+            "  -f         use a registered (fixed) file\n"
+            "  -d         open with O_DIRECT and sweep chunk sizes %d..%d\n"
+            "  -c chunk   with -d, run a single chunk size\n"
+            BENCH_MATRIX_USAGE
+            "             (-d replaces -R/-W with its own chunk sweep)\n",
+            prog, MAX_QUEUE_DEPTH, DIO_MIN_CHUNK, DIO_MAX_CHUNK);
+}
+
+int run_direct(struct uring *ring, int qd, const struct dio_align *align,
+               char *buf, size_t single_chunk);
+
+int main(int argc, char *argv[])
+{
+    struct bench_matrix matrix;
+    bench_matrix_init(&matrix);
+
+    int single_qd = 0;
+    int fixed_bufs = 0;
+    int fixed_file = 0;
+    int direct = 0;
+    size_t single_chunk = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "q:rfdc:h" BENCH_MATRIX_OPTS)) != -1)
+    {
+        int handled = bench_matrix_option(&matrix, opt, optarg);
+        if (handled < 0)
+            return -1;
+        if (handled)
+            continue;
+
+        switch (opt)
+        {
+        case 'q':
+            single_qd = atoi(optarg);
+            if (single_qd < 1 || single_qd > MAX_QUEUE_DEPTH)
+            {
+                fprintf(stderr, "Queue depth must be in 1..%d\n", MAX_QUEUE_DEPTH);
+                return -1;
+            }
+            break;
+        case 'r':
+            fixed_bufs = 1;
+            break;
+        case 'f':
+            fixed_file = 1;
+            break;
+        case 'd':
+            direct = 1;
+            break;
+        case 'c':
+            if (bench_parse_size(optarg, &single_chunk) != 0)
+                return -1;
+            break;
+        default:
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    bench_matrix_print_offsets(&matrix);
+
+    int fd = open(matrix.file_name, O_RDWR | (direct ? O_DIRECT : 0));
+    if (fd == -1)
+    {
+        perror("open");
+        return -1;
+    }
+
+    size_t buf_size = bench_matrix_max_file_size(&matrix);
+    char *buf = bench_buf_alloc(&matrix, buf_size);
+    if (!buf)
+    {
+        close(fd);
+        return -1;
+    }
+
+    struct dio_align align = { 0, 0 };
+    if (direct)
+    {
+        if (dio_get_align(fd, &align) != 0)
+        {
+            close(fd);
+            bench_buf_free(&matrix, buf, buf_size);
+            return -1;
+        }
+        printf("O_DIRECT: memory alignment %zu, offset alignment %zu\n",
+               align.mem_align, align.ofs_align);
+    }
+
+    int first_qd = single_qd ? single_qd : 1;
+    int last_qd  = single_qd ? single_qd : MAX_QUEUE_DEPTH;
+
+    int points = bench_matrix_points(&matrix);
+    for (int i = 0; i < points; ++i)
+    {
+        bench_matrix_get(&matrix, i, &cfg);
+        if (points > 1)
+            bench_config_print(&cfg);
+        if (bench_config_check(&cfg) != 0 || bench_prepare_file(&cfg) != 0
+            || bench_offsets_generate(&cfg) != 0)
+            continue;
+
+        for (int qd = first_qd; qd <= last_qd; qd <<= 1)
+        {
+            /* random_write_sync links a write and an fsync, so each op needs two SQEs */
+            struct uring ring;
+            if (uring_init(&ring, 2 * qd, fd, fixed_file, buf, buf_size, fixed_bufs) != 0)
+                break;
+
+            printf("[QD=%d%s%s%s]\n", qd, direct ? ", O_DIRECT" : "",
+                   fixed_bufs ? ", registered buffers" : "",
+                   fixed_file ? ", fixed file" : "");
+
+            if (direct)
+            {
+                run_direct(&ring, qd, &align, buf, single_chunk);
+            }
+            else
+            {
+                MEASURE_TIME("1. Sequential Read",          { seq_read(&ring, qd, buf); })
+                MEASURE_TIME("2. Sequential Write",         { seq_write(&ring, qd, buf); })
+                MEASURE_TIME("3. Random Read",              { random_read(&ring, qd, buf); })
+                MEASURE_TIME("4. Random Buffered Write",    { random_write_buffered(&ring, qd, buf); })
+                MEASURE_TIME("5. Random Sync Write",        { random_write_sync(&ring, qd, buf); })
+            }
+
+            uring_exit(&ring);
+        }
+    }
+
+    close(fd);
+    bench_buf_free(&matrix, buf, buf_size);
+}
+
+/*
+ * Sweep chunk sizes at one queue depth with the page cache bypassed. The
+ * chunk settings of the current matrix point are restored afterwards.
+ */
+int run_direct(struct uring *ring, int qd, const struct dio_align *align,
+               char *buf, size_t single_chunk)
+{
+    struct bench_config saved = cfg;
+    size_t first = single_chunk ? single_chunk : DIO_MIN_CHUNK;
+    size_t last  = single_chunk ? single_chunk : DIO_MAX_CHUNK;
+
+    for (size_t chunk = first; chunk <= last; chunk <<= 1)
+    {
+        printf("  [chunk=%zu]\n", chunk);
+        if (dio_check(align, chunk, saved.file_size, buf) != 0)
+            continue;
+
+        cfg.read_chunk = cfg.write_chunk = chunk;
+        cfg.nums_random = dio_random_ops(chunk, saved.file_size, saved.nums_random);
+        if (bench_offsets_generate(&cfg) != 0)
+            break;
+        size_t random_bytes = (size_t)cfg.nums_random * chunk;
+
+        MEASURE_IO("1. Sequential Read",        cfg.file_size, cfg.file_size / chunk,   { seq_read(ring, qd, buf); })
+        MEASURE_IO("2. Sequential Write",       cfg.file_size, cfg.file_size / chunk,   { seq_write(ring, qd, buf); })
+        MEASURE_IO("3. Random Read",            random_bytes, cfg.nums_random,          { random_read(ring, qd, buf); })
+        MEASURE_IO("4. Random Buffered Write",  random_bytes, cfg.nums_random,          { random_write_buffered(ring, qd, buf); })
+        MEASURE_IO("5. Random Sync Write",      random_bytes, cfg.nums_random,          { random_write_sync(ring, qd, buf); })
+    }
+
+    cfg = saved;
+    return bench_offsets_generate(&cfg);
+}
+
+int seq_read(struct uring *ring, int qd, char *buf)
+{
+    for (size_t ofs = 0; ofs < cfg.file_size; ofs += cfg.read_chunk)
+    {
+        uring_prep_rw(ring, 0, buf + ofs, cfg.read_chunk, ofs, 0);
+        if (uring_submit_and_wait(ring, qd - 1) != 0)
+            return -1;
+    }
+    return uring_submit_and_wait(ring, 0);
+}
+
+int seq_write(struct uring *ring, int qd, const char *buf)
+{
+    for (size_t ofs = 0; ofs < cfg.file_size; ofs += cfg.write_chunk)
+    {
+        uring_prep_rw(ring, 1, (char *)buf + ofs, cfg.write_chunk, ofs, 0);
+        if (uring_submit_and_wait(ring, qd - 1) != 0)
+            return -1;
+    }
+    if (uring_submit_and_wait(ring, 0) != 0)
+        return -1;
+    return uring_fsync(ring);
+}
+
+int random_read(struct uring *ring, int qd, char *buf)
+{
+    for (int i = 0; i < cfg.nums_random; ++i)
+    {
+        off_t ofs = bench_offsets[OFS_READ][i];
+        uring_prep_rw(ring, 0, buf + ofs, cfg.read_chunk, ofs, 0);
+        if (uring_submit_and_wait(ring, qd - 1) != 0)
+            return -1;
+    }
+    return uring_submit_and_wait(ring, 0);
+}
+
+int random_write_buffered(struct uring *ring, int qd, const char *buf)
+{
+    for (int i = 0; i < cfg.nums_random; ++i)
+    {
+        off_t ofs = bench_offsets[OFS_WRITE][i];
+        uring_prep_rw(ring, 1, (char *)buf + ofs, cfg.write_chunk, ofs, 0);
+        if (uring_submit_and_wait(ring, qd - 1) != 0)
+            return -1;
+    }
+    if (uring_submit_and_wait(ring, 0) != 0)
+        return -1;
+    return uring_fsync(ring);
+}
+
+int random_write_sync(struct uring *ring, int qd, const char *buf)
+{
+    /* each op is a write linked to an fsync; up to qd such pairs in flight */
+    for (int i = 0; i < cfg.nums_random; ++i)
+    {
+        off_t ofs = bench_offsets[OFS_WRITE_SYNC][i];
+        uring_prep_rw(ring, 1, (char *)buf + ofs, cfg.write_chunk, ofs, 1);
+        uring_prep_fsync(ring);
+        if (uring_submit_and_wait(ring, 2 * (qd - 1)) != 0)
+            return -1;
+    }
+    return uring_submit_and_wait(ring, 0);
+}
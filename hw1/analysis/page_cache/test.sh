@@ -3,49 +3,62 @@
 # Configuration
 FILE_NAME="100MB.bin"
 FILE_SIZE_MB=100
-SOURCES=("HW111.c" "HW112.c" "HW113.c")
+SRC_DIR="$(dirname "$0")/../.."
+BACKENDS=("stdio" "syscall" "mmap") # bench.c backends standing in for HW111/112/113
 COOL_DOWN_TIME=10 # Seconds to wait between tests
 
-# Check for root privileges (required to drop caches and run fstrim)
+# Root is optional: bench -C evicts the test file itself (fdatasync +
+# POSIX_FADV_DONTNEED). With sudo the SSD is also trimmed and the whole
+# page cache dropped before every backend.
 if [ "$EUID" -ne 0 ]; then
-  echo "Error: Please run this script with sudo."
-  exit 1
+  echo "Note: not root, skipping fstrim and drop_caches (bench -C still evicts the test file)."
 fi
 
 echo "=========================================================="
 echo "    File System I/O Benchmark Automation (Hardware Aware)"
 echo "=========================================================="
 
-for SRC in "${SOURCES[@]}"; do
-    PROG="${SRC%.c}" # Extract program name (e.g., HW111)
+PROG="bench"
 
+# Test file generator (parallel, seeded), replaces dd from /dev/urandom
+gcc -O2 -pthread -o genfile "$SRC_DIR/genfile.c"
+if [ $? -ne 0 ]; then
+    echo "Error: Compilation of genfile.c failed."
+    exit 1
+fi
+
+for BACKEND in "${BACKENDS[@]}"; do
     echo ""
-    echo ">>> Testing Module: $PROG"
+    echo ">>> Testing Backend: $BACKEND"
 
     # 1. Compilation
-    echo "   [1/5] Compiling $SRC..."
-    gcc -o "$PROG" "$SRC"
+    echo "   [1/5] Compiling bench.c..."
+    gcc -pthread -o "$PROG" "$SRC_DIR/bench.c" -lm
     if [ $? -ne 0 ]; then
-        echo "   Error: Compilation of $SRC failed. Skipping..."
+        echo "   Error: Compilation of bench.c failed. Skipping..."
         continue
     fi
 
     # 2. Data Preparation
-    # Using /dev/urandom to bypass filesystem-level compression/deduplication
-    echo "   [2/5] Generating $FILE_SIZE_MB MB test file with dd..."
-    dd if=/dev/urandom of=$FILE_NAME bs=1M count=$FILE_SIZE_MB status=none
+    # Pseudo-random content to bypass filesystem-level compression/deduplication
+    echo "   [2/5] Generating $FILE_SIZE_MB MB test file..."
+    ./genfile -s ${FILE_SIZE_MB}M $FILE_NAME
 
     # 3. Environment Preparation (The "Cold Start" Protocol)
     # This ensures neither the OS nor the SSD Hardware buffers affect the result
     echo "   [3/5] Cleaning caches and trimming SSD..."
     sync                         # Flush dirty pages from RAM to Disk
-    fstrim -v /                  # Inform SSD about deleted blocks to allow Background GC
-    echo 3 > /proc/sys/vm/drop_caches # Clear OS Page Cache, dentries, and inodes
+    if [ "$EUID" -eq 0 ]; then
+        fstrim -v /                  # Inform SSD about deleted blocks to allow Background GC
+        echo 3 > /proc/sys/vm/drop_caches # Clear OS Page Cache, dentries, and inodes
+    fi
 
     # 4. Execution
     echo "   [4/5] Executing Benchmark..."
     echo "----------------------------------------------------------"
-    sudo ./"$PROG"
+    # -C evicts just the test file from the page cache before every phase,
+    # -r shows how much of it is cached and how much memory is dirty around it
+    ./"$PROG" -b "$BACKEND" -C -r
     echo "----------------------------------------------------------"
 
     # 5. Cleanup and Hardware Cool-down
@@ -53,13 +66,14 @@ for SRC in "${SOURCES[@]}"; do
     rm "$PROG"
 
     # Wait to allow SSD SLC Cache to flush and controller to stabilize
-    if [ "$SRC" != "${SOURCES[-1]}" ]; then
+    if [ "$BACKEND" != "${BACKENDS[-1]}" ]; then
         echo "   Waiting $COOL_DOWN_TIME seconds for SSD hardware recovery..."
         sleep $COOL_DOWN_TIME
     fi
 done
 
 # Final Cleanup of the test binary and data
+rm -f genfile
 if [ -f "$FILE_NAME" ]; then
     rm "$FILE_NAME"
 fi
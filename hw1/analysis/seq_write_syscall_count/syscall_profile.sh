@@ -3,7 +3,8 @@
 # Configuration
 FILE_NAME="100MB.bin"
 FILE_SIZE_MB=100
-SOURCES=("HW111.c" "HW112.c") 
+SRC_DIR="$(dirname "$0")/../.."
+BACKENDS=("stdio" "syscall") # C library vs. system calls, both from bench.c
 COOL_DOWN_TIME=10 
 
 if [ "$EUID" -ne 0 ]; then
@@ -15,24 +16,32 @@ echo "=========================================================="
 echo "    Syscall Profiling: C Library vs. System Calls"
 echo "=========================================================="
 
-for SRC in "${SOURCES[@]}"; do
-    PROG="${SRC%.c}"
-    LOG_FILE="result_${PROG}.txt" # Save results to a permanent file
+PROG="bench"
+
+# Test file generator (parallel, seeded), replaces dd from /dev/urandom
+gcc -O2 -pthread -o genfile "$SRC_DIR/genfile.c"
+if [ $? -ne 0 ]; then
+    echo "Error: Compilation of genfile.c failed."
+    exit 1
+fi
+
+for BACKEND in "${BACKENDS[@]}"; do
+    LOG_FILE="result_${BACKEND}.txt" # Save results to a permanent file
 
     echo ""
-    echo ">>> Testing Module: $PROG"
+    echo ">>> Testing Backend: $BACKEND"
 
     # 1. Compilation
-    echo "   [1/5] Compiling $SRC..."
-    gcc -o "$PROG" "$SRC"
+    echo "   [1/5] Compiling bench.c..."
+    gcc -pthread -o "$PROG" "$SRC_DIR/bench.c" -lm
     if [ $? -ne 0 ]; then
-        echo "   Error: Compilation of $SRC failed."
+        echo "   Error: Compilation of bench.c failed."
         continue
     fi
 
     # 2. Data Preparation
     echo "   [2/5] Generating $FILE_SIZE_MB MB test file ($FILE_NAME)..."
-    dd if=/dev/urandom of=$FILE_NAME bs=1M count=$FILE_SIZE_MB status=none
+    ./genfile -s ${FILE_SIZE_MB}M $FILE_NAME
 
     # 3. Environment Preparation
     echo "   [3/5] Cleaning caches and trimming SSD..."
@@ -41,10 +50,12 @@ for SRC in "${SOURCES[@]}"; do
     echo 3 > /proc/sys/vm/drop_caches
 
     # 4. Execution & Profiling
-    echo "   [4/5] Profiling System Calls via strace..."
+    echo "   [4/5] Profiling System Calls of the sequential write..."
     echo "----------------------------------------------------------"
-    # Run strace and save the FULL output to a file, then cat it to screen
-    strace -c ./"$PROG" > /dev/null 2> "$LOG_FILE"
+    # -u counts syscalls, CPU time and context switches per phase without a
+    # tracer, so the timings in the log are valid too; -x 2 runs only the
+    # sequential write this directory is about
+    ./"$PROG" -b "$BACKEND" -x 2 -u > "$LOG_FILE"
     cat "$LOG_FILE" # Print the full table so you can see it
     echo "----------------------------------------------------------"
     echo "   Full log saved to: $LOG_FILE"
@@ -53,16 +64,17 @@ for SRC in "${SOURCES[@]}"; do
     echo "   [5/5] Cleaning up and cooling down..."
     rm "$PROG"
 
-    if [ "$SRC" != "${SOURCES[-1]}" ]; then
+    if [ "$BACKEND" != "${BACKENDS[-1]}" ]; then
         echo "   Waiting $COOL_DOWN_TIME seconds for hardware recovery..."
         sleep $COOL_DOWN_TIME
     fi
 done
 
+rm -f genfile
 if [ -f "$FILE_NAME" ]; then
     rm "$FILE_NAME"
 fi
 
 echo ""
-echo "Profiling completed. Check result_HW111.txt and result_HW112.txt."
+echo "Profiling completed. Check result_stdio.txt and result_syscall.txt."
 echo "=========================================================="
\ No newline at end of file
@@ -0,0 +1,49 @@
+#ifndef BACKEND_H
+#define BACKEND_H
+
+/*
+ * I/O backend interface of the benchmark engine (bench.c).
+ *
+ * A backend only knows how to move bytes: positional read/write of one
+ * chunk, making a range durable, and opening/closing the test file. The
+ * workloads, offsets, timing, latency and trace handling live in the engine,
+ * so every backend runs exactly the same operations. Adding a backend means
+ * writing a backend_<name>.h with these five functions (plus drop, if it
+ * caches anything itself) and listing it in
+ * the engine's backends[] table.
+ */
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "bench_config.h"
+
+struct bench_file {
+    const struct bench_config *cfg;
+    int fd;
+    void *priv;             /* backend private state */
+};
+
+struct backend {
+    const char *name;
+    const char *desc;
+    int     (*open)     (struct bench_file *f, const struct bench_config *cfg);
+    /* Both return the bytes transferred; anything but `len` is a failure */
+    ssize_t (*read_at)  (struct bench_file *f, char *buf, size_t len, off_t ofs);
+    ssize_t (*write_at) (struct bench_file *f, const char *buf, size_t len, off_t ofs);
+    /* Make [ofs, ofs + len) durable, or the whole file when `len` is 0 */
+    int     (*flush)    (struct bench_file *f, off_t ofs, size_t len);
+    void    (*close)    (struct bench_file *f);
+    /*
+     * Optional: forget data cached above the page cache (stdio buffers,
+     * mapped pages) so that a cold-cache phase really reaches the kernel
+     */
+    int     (*drop)     (struct bench_file *f);
+    /*
+     * Optional: hand writes buffered above the page cache to the kernel,
+     * without waiting for them, so the background flusher can see them
+     */
+    int     (*push)     (struct bench_file *f);
+};
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef BACKEND_MMAP_H
+#define BACKEND_MMAP_H
+
+/*
+ * Shared file mapping, as in HW113: reads and writes are memcpy, a flush
+ * msyncs the pages covering the range (or the whole mapping) and a
+ * whole-file flush also fsyncs for the metadata.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <sys/mman.h>
+
+#include "backend.h"
+#include "sys_acct.h"
+
+static int mmap_open(struct bench_file *f, const struct bench_config *cfg)
+{
+    f->fd = open(cfg->file_name, O_RDWR);
+    if (f->fd == -1)
+    {
+        perror("open");
+        return -1;
+    }
+
+    char *map = mmap(NULL, cfg->file_size, PROT_READ | PROT_WRITE, MAP_SHARED, f->fd, 0);
+    if (map == MAP_FAILED)
+    {
+        perror("mmap");
+        close(f->fd);
+        return -1;
+    }
+    huge_advise_map(map, cfg->file_size, cfg->huge);
+    f->priv = map;
+    return 0;
+}
+
+static ssize_t mmap_read_at(struct bench_file *f, char *buf, size_t len, off_t ofs)
+{
+    memcpy(buf, (char *)f->priv + ofs, len);
+    return len;
+}
+
+static ssize_t mmap_write_at(struct bench_file *f, const char *buf, size_t len, off_t ofs)
+{
+    memcpy((char *)f->priv + ofs, buf, len);
+    return len;
+}
+
+static int mmap_flush(struct bench_file *f, off_t ofs, size_t len)
+{
+    char *map = f->priv;
+
+    if (len == 0)
+    {
+        if (SC(SC_MSYNC, msync(map, f->cfg->file_size, MS_SYNC)) != 0)
+        {
+            perror("msync");
+            return -1;
+        }
+        return SC(SC_FSYNC, fsync(f->fd));
+    }
+
+    long page_size = getpagesize();
+    char *start = (char *)((uintptr_t)(map + ofs) & ~(page_size - 1));
+    return SC(SC_MSYNC, msync(start, map + ofs + len - start, MS_SYNC));
+}
+
+/* Unmap our pages so the kernel may evict them; the data stays in the file */
+static int mmap_drop(struct bench_file *f)
+{
+    if (msync(f->priv, f->cfg->file_size, MS_SYNC) != 0
+        || madvise(f->priv, f->cfg->file_size, MADV_DONTNEED) != 0)
+    {
+        perror("mmap drop");
+        return -1;
+    }
+    return 0;
+}
+
+static void mmap_close(struct bench_file *f)
+{
+    munmap(f->priv, f->cfg->file_size);
+    close(f->fd);
+}
+
+static const struct backend mmap_backend = {
+    .name       = "mmap",
+    .desc       = "memcpy on a shared mapping, msync",
+    .open       = mmap_open,
+    .read_at    = mmap_read_at,
+    .write_at   = mmap_write_at,
+    .flush      = mmap_flush,
+    .close      = mmap_close,
+    .drop       = mmap_drop,
+};
+
+#endif
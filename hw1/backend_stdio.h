@@ -0,0 +1,139 @@
+#ifndef BACKEND_STDIO_H
+#define BACKEND_STDIO_H
+
+/*
+ * C library streams, as in HW111. The stream position is tracked so that
+ * back-to-back ops (the sequential phases) do not pay for an fseeko(),
+ * which would also throw away the stdio buffer.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "backend.h"
+#include "sys_acct.h"
+
+struct stdio_file {
+    FILE *fp;
+    off_t pos;              /* -1 when unknown */
+    int writing;            /* last op was a write; switching needs a seek */
+};
+
+static int stdio_open(struct bench_file *f, const struct bench_config *cfg)
+{
+    struct stdio_file *s = calloc(1, sizeof(*s));
+    if (!s)
+    {
+        perror("calloc");
+        return -1;
+    }
+
+    s->fp = fopen(cfg->file_name, "r+b");
+    if (!s->fp)
+    {
+        perror("fopen");
+        free(s);
+        return -1;
+    }
+    s->pos = -1;
+
+    f->fd = fileno(s->fp);
+    f->priv = s;
+    return 0;
+}
+
+static int stdio_seek(struct stdio_file *s, off_t ofs, int writing)
+{
+    /* ISO C requires a positioning call between reads and writes */
+    if (s->pos == ofs && s->writing == writing)
+        return 0;
+
+    if (fseeko(s->fp, ofs, SEEK_SET) != 0)
+    {
+        perror("fseeko");
+        s->pos = -1;
+        return -1;
+    }
+    s->pos = ofs;
+    s->writing = writing;
+    return 0;
+}
+
+static ssize_t stdio_read_at(struct bench_file *f, char *buf, size_t len, off_t ofs)
+{
+    struct stdio_file *s = f->priv;
+    if (stdio_seek(s, ofs, 0) != 0)
+        return -1;
+
+    size_t n = fread(buf, 1, len, s->fp);
+    s->pos = n == len ? s->pos + (off_t)n : -1;
+    return n;
+}
+
+static ssize_t stdio_write_at(struct bench_file *f, const char *buf, size_t len, off_t ofs)
+{
+    struct stdio_file *s = f->priv;
+    if (stdio_seek(s, ofs, 1) != 0)
+        return -1;
+
+    size_t n = fwrite(buf, 1, len, s->fp);
+    s->pos = n == len ? s->pos + (off_t)n : -1;
+    return n;
+}
+
+static int stdio_flush(struct bench_file *f, off_t ofs, size_t len)
+{
+    struct stdio_file *s = f->priv;
+    (void)ofs;
+    (void)len;
+
+    if (fflush(s->fp) != 0)
+    {
+        perror("fflush");
+        return -1;
+    }
+    return SC(SC_FSYNC, fsync(f->fd));
+}
+
+static int stdio_push(struct bench_file *f)
+{
+    struct stdio_file *s = f->priv;
+    if (fflush(s->fp) != 0)
+    {
+        perror("fflush");
+        return -1;
+    }
+    return 0;
+}
+
+static int stdio_drop(struct bench_file *f)
+{
+    struct stdio_file *s = f->priv;
+    if (stdio_push(f) != 0)
+        return -1;
+    /* the next op seeks, which discards the read buffer */
+    s->pos = -1;
+    return 0;
+}
+
+static void stdio_close(struct bench_file *f)
+{
+    struct stdio_file *s = f->priv;
+    fclose(s->fp);
+    free(s);
+}
+
+static const struct backend stdio_backend = {
+    .name       = "stdio",
+    .desc       = "fread/fwrite, fflush + fsync",
+    .open       = stdio_open,
+    .read_at    = stdio_read_at,
+    .write_at   = stdio_write_at,
+    .flush      = stdio_flush,
+    .close      = stdio_close,
+    .drop       = stdio_drop,
+    .push       = stdio_push,
+};
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef BACKEND_SYSCALL_H
+#define BACKEND_SYSCALL_H
+
+/*
+ * Plain system calls, as in HW112: pread/pwrite and fsync. The direct
+ * variant opens the file with O_DIRECT so every op bypasses the page cache;
+ * it refuses chunk sizes the device cannot transfer directly.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "backend.h"
+#include "dio.h"
+#include "sys_acct.h"
+
+static int syscall_open_flags(struct bench_file *f, const struct bench_config *cfg, int flags)
+{
+    f->fd = open(cfg->file_name, O_RDWR | flags);
+    if (f->fd == -1)
+    {
+        perror("open");
+        return -1;
+    }
+    f->priv = NULL;
+    return 0;
+}
+
+static int syscall_open(struct bench_file *f, const struct bench_config *cfg)
+{
+    return syscall_open_flags(f, cfg, 0);
+}
+
+static int direct_open(struct bench_file *f, const struct bench_config *cfg)
+{
+    if (syscall_open_flags(f, cfg, O_DIRECT) != 0)
+        return -1;
+
+    /* the engine's buffer is page aligned, so only the chunks need checking */
+    struct dio_align align;
+    if (dio_get_align(f->fd, &align) != 0
+        || dio_check(&align, cfg->read_chunk, cfg->file_size, NULL) != 0
+        || dio_check(&align, cfg->write_chunk, cfg->file_size, NULL) != 0)
+    {
+        close(f->fd);
+        return -1;
+    }
+    return 0;
+}
+
+static ssize_t syscall_read_at(struct bench_file *f, char *buf, size_t len, off_t ofs)
+{
+    return SC(SC_PREAD, pread(f->fd, buf, len, ofs));
+}
+
+static ssize_t syscall_write_at(struct bench_file *f, const char *buf, size_t len, off_t ofs)
+{
+    return SC(SC_PWRITE, pwrite(f->fd, buf, len, ofs));
+}
+
+static int syscall_flush(struct bench_file *f, off_t ofs, size_t len)
+{
+    (void)ofs;
+    (void)len;
+    return SC(SC_FSYNC, fsync(f->fd));
+}
+
+static void syscall_close(struct bench_file *f)
+{
+    close(f->fd);
+}
+
+static const struct backend syscall_backend = {
+    .name       = "syscall",
+    .desc       = "pread/pwrite, fsync",
+    .open       = syscall_open,
+    .read_at    = syscall_read_at,
+    .write_at   = syscall_write_at,
+    .flush      = syscall_flush,
+    .close      = syscall_close,
+};
+
+static const struct backend direct_backend = {
+    .name       = "direct",
+    .desc       = "pread/pwrite on an O_DIRECT descriptor, fsync",
+    .open       = direct_open,
+    .read_at    = syscall_read_at,
+    .write_at   = syscall_write_at,
+    .flush      = syscall_flush,
+    .close      = syscall_close,
+};
+
+#endif
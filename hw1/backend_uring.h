@@ -0,0 +1,81 @@
+#ifndef BACKEND_URING_H
+#define BACKEND_URING_H
+
+/*
+ * io_uring at queue depth 1: each op is one SQE submitted and reaped
+ * before the call returns, which is what a synchronous read_at/write_at
+ * interface allows. HW114 keeps the deeper queue depth sweeps.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "backend.h"
+#include "uring.h"
+
+static int uring_backend_open(struct bench_file *f, const struct bench_config *cfg)
+{
+    struct uring *ring = malloc(sizeof(*ring));
+    if (!ring)
+    {
+        perror("malloc");
+        return -1;
+    }
+
+    f->fd = open(cfg->file_name, O_RDWR);
+    if (f->fd == -1)
+    {
+        perror("open");
+        free(ring);
+        return -1;
+    }
+
+    if (uring_init(ring, 2, f->fd, 0, NULL, 0, 0) != 0)
+    {
+        close(f->fd);
+        free(ring);
+        return -1;
+    }
+    f->priv = ring;
+    return 0;
+}
+
+static ssize_t uring_backend_read_at(struct bench_file *f, char *buf, size_t len, off_t ofs)
+{
+    uring_prep_rw(f->priv, 0, buf, len, ofs, 0);
+    return uring_submit_and_wait(f->priv, 0) == 0 ? (ssize_t)len : -1;
+}
+
+static ssize_t uring_backend_write_at(struct bench_file *f, const char *buf, size_t len, off_t ofs)
+{
+    uring_prep_rw(f->priv, 1, (char *)buf, len, ofs, 0);
+    return uring_submit_and_wait(f->priv, 0) == 0 ? (ssize_t)len : -1;
+}
+
+static int uring_backend_flush(struct bench_file *f, off_t ofs, size_t len)
+{
+    (void)ofs;
+    (void)len;
+    return uring_fsync(f->priv);
+}
+
+static void uring_backend_close(struct bench_file *f)
+{
+    uring_exit(f->priv);
+    free(f->priv);
+    close(f->fd);
+}
+
+static const struct backend uring_backend = {
+    .name       = "uring",
+    .desc       = "io_uring READ/WRITE at queue depth 1, IORING_OP_FSYNC",
+    .open       = uring_backend_open,
+    .read_at    = uring_backend_read_at,
+    .write_at   = uring_backend_write_at,
+    .flush      = uring_backend_flush,
+    .close      = uring_backend_close,
+};
+
+#endif
@@ -0,0 +1,719 @@
+#define _GNU_SOURCE
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/time.h>
+#include <sys/types.h>
+
+#include "bench_config.h"
+#include "lat_hist.h"
+#include "trace.h"
+#include "results.h"
+#include "page_cache.h"
+#include "sys_acct.h"
+#include "perf_ctr.h"
+#include "job.h"
+#include "block_cache.h"
+#include "flusher.h"
+#include "backend.h"
+#include "backend_stdio.h"
+#include "backend_syscall.h"
+#include "backend_mmap.h"
+#include "backend_uring.h"
+
+/*
+ * MEASURE_TIME that also files the sample as repetition of phase `idx` in
+ * `res`. With -C the test file of `be`/`f` is evicted first, untimed; with
+ * -r its page cache state is sampled around (and with -t during) the phase.
+ * With -c the user-space block cache reports its share of the traffic, with
+ * -A the flusher its background work and the final flush.
+ */
+#define MEASURE_PHASE(res, idx, name, bytes, ops, code_block) do {      \
+    struct timeval __tv1, __tv2;                                        \
+    if (cold_cache)                                                     \
+        evict_cache(be, &f);                                            \
+    cache_phase_begin(f.fd, cfg.file_size);                             \
+    lat_phase_begin();                                                  \
+    bcache_phase_begin(&bcache);                                        \
+    flusher_phase_begin();                                              \
+    sys_acct_begin();                                                   \
+    perf_phase_begin();                                                 \
+    gettimeofday(&__tv1, NULL);                                         \
+    code_block                                                          \
+    gettimeofday(&__tv2, NULL);                                         \
+    perf_phase_end();                                                   \
+    sys_acct_end();                                                     \
+    unsigned long __diff =                                              \
+        1000000 * (__tv2.tv_sec - __tv1.tv_sec)                         \
+        + (__tv2.tv_usec - __tv1.tv_usec);                              \
+    printf("%-25s:   %.4f sec\n", name, __diff / 1000000.0);            \
+    cache_phase_end(f.fd, cfg.file_size);                               \
+    sys_acct_print();                                                   \
+    perf_phase_print(bytes);                                            \
+    bcache_print(&bcache);                                              \
+    flusher_print();                                                    \
+    lat_phase_end();                                                    \
+    results_add((res), (idx), (name), (bytes), (ops), __diff / 1000000.0); \
+} while (0);
+
+/* Every backend the engine can run, in the order `-b all` runs them */
+static const struct backend *const backends[] = {
+    &stdio_backend,
+    &syscall_backend,
+    &direct_backend,
+    &mmap_backend,
+    &uring_backend,
+};
+#define NR_BACKENDS     (int)(sizeof(backends) / sizeof(backends[0]))
+
+static struct bench_config cfg;
+static int cold_cache;
+static int reps = 1;
+static struct job_list jobs;
+static size_t bcache_size;
+static struct bcache bcache;            /* in use while bcache.nblocks != 0 */
+static unsigned phase_mask = ~0u;       /* bit i set: run phase i + 1 */
+
+#define NR_PHASES       7
+#define PHASE_ON(idx)   (phase_mask >> (idx) & 1)
+
+int seq_read                (const struct backend *be, struct bench_file *f, char *buf);
+int seq_write               (const struct backend *be, struct bench_file *f, const char *buf);
+int random_read             (const struct backend *be, struct bench_file *f, char *buf);
+int random_write_buffered   (const struct backend *be, struct bench_file *f, const char *buf);
+int random_write_sync       (const struct backend *be, struct bench_file *f, const char *buf);
+int replay                  (const struct backend *be, struct bench_file *f, char *buf,
+                             const struct trace *t, struct trace_clock *clk);
+int run_job                 (const struct backend *be, struct bench_file *f, char *buf,
+                             const struct job *j, int idx, struct job_stats *st);
+
+int run_backend(const struct backend *be, char *buf, const struct trace *replay_trace,
+                struct results *res);
+void evict_cache(const struct backend *be, struct bench_file *f);
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-l] [-u] [-p] [-b backends] [-x phases] [-C] [-r] [-t msec] [-k reps] [-o file]\n"
+            "          [-B size] [-j jobfile] [-c size] [-A size]\n"
+            "          [matrix options] [-T file | -P file [-O]]\n"
+            "  -l         record per-operation latency percentiles\n"
+            "  -u         account syscalls, CPU time and context switches per\n"
+            "             phase, in process (no strace needed)\n"
+            "  -p         count cycles, instructions, LLC/dTLB misses and page\n"
+            "             faults per phase (software events if no PMU access)\n"
+            "  -b list    comma separated backends to run, or all (default):\n"
+            "             stdio, syscall, direct, mmap, uring\n"
+            "  -x list    comma separated phases to run, 1-5 (6-7 with -A),\n"
+            "             or all (default), e.g. -x 2 for the sequential write\n"
+            "  -C         evict the test file from the page cache before every\n"
+            "             phase (fdatasync + fadvise, no root needed)\n"
+            "  -r         report the resident share of the test file and the\n"
+            "             system Dirty/Writeback before and after every phase\n"
+            "  -t msec    with -r, also sample every msec during the phase\n"
+            "             (from a thread, which competes for the CPU)\n"
+            "  -k reps    run every phase reps times and report mean, stddev,\n"
+            "             min and the 95%% confidence interval\n"
+            "  -o file    also write one record per phase with run metadata,\n"
+            "             as JSON Lines (.json, .jsonl) or CSV (.csv)\n"
+            "  -B size    streaming: cycle through a ring of this size instead\n"
+            "             of a buffer as large as the file (e.g. 64M), for\n"
+            "             files larger than memory\n"
+            "  -j file    run the mixed workloads of a fio-style job file (see\n"
+            "             job.h) instead of the five phases; implies -l\n"
+            "  -c size    put a write-back block cache of this size (e.g. 16M)\n"
+            "             in front of the backend: CLOCK eviction, dirty\n"
+            "             blocks written back sorted and coalesced on flush\n"
+            "  -A size    also run phases 2 and 4 with a background flusher\n"
+            "             that syncs every size bytes written (e.g. 8M), so\n"
+            "             the final flush only waits for the rest\n"
+            BENCH_MATRIX_USAGE
+            TRACE_USAGE, prog);
+}
+
+/* Parse "-b a,b,c" into `selected`; returns -1 on an unknown name */
+static int parse_backends(const char *arg, int *selected)
+{
+    if (strcmp(arg, "all") == 0)
+    {
+        for (int i = 0; i < NR_BACKENDS; ++i)
+            selected[i] = 1;
+        return 0;
+    }
+
+    memset(selected, 0, NR_BACKENDS * sizeof(*selected));
+    while (*arg)
+    {
+        size_t len = strcspn(arg, ",");
+        int i;
+        for (i = 0; i < NR_BACKENDS; ++i)
+            if (strlen(backends[i]->name) == len && strncmp(arg, backends[i]->name, len) == 0)
+                break;
+        if (i == NR_BACKENDS)
+        {
+            fprintf(stderr, "Unknown backend '%.*s'\n", (int)len, arg);
+            return -1;
+        }
+        selected[i] = 1;
+        arg += len + (arg[len] == ',');
+    }
+    return 0;
+}
+
+/* Parse "-x 2,4" into `phase_mask`; returns -1 on a phase that does not exist */
+static int parse_phases(const char *arg)
+{
+    if (strcmp(arg, "all") == 0)
+    {
+        phase_mask = ~0u;
+        return 0;
+    }
+
+    phase_mask = 0;
+    while (*arg)
+    {
+        char *end;
+        long p = strtol(arg, &end, 10);
+        if (end == arg || p < 1 || p > NR_PHASES || (*end != ',' && *end != '\0'))
+        {
+            fprintf(stderr, "Unknown phase '%.*s'\n", (int)strcspn(arg, ","), arg);
+            return -1;
+        }
+        phase_mask |= 1u << (p - 1);
+        arg = end + (*end == ',');
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    struct bench_matrix matrix;
+    bench_matrix_init(&matrix);
+
+    int selected[NR_BACKENDS];
+    parse_backends("all", selected);
+
+    int opt;
+    while ((opt = getopt(argc, argv, "lupb:x:Crt:k:o:B:j:c:A:" BENCH_MATRIX_OPTS TRACE_OPTS)) != -1)
+    {
+        int handled = bench_matrix_option(&matrix, opt, optarg);
+        if (handled < 0)
+            return -1;
+        if (handled)
+            continue;
+        if (trace_option(opt, optarg))
+            continue;
+
+        switch (opt)
+        {
+        case 'l':
+            lat_enabled = 1;
+            break;
+        case 'u':
+            sys_acct_enabled = 1;
+            break;
+        case 'p':
+            perf_enabled = 1;
+            break;
+        case 'b':
+            if (parse_backends(optarg, selected) != 0)
+                return -1;
+            break;
+        case 'x':
+            if (parse_phases(optarg) != 0)
+                return -1;
+            break;
+        case 'C':
+            cold_cache = 1;
+            break;
+        case 'r':
+            cache_report = 1;
+            break;
+        case 't':
+            cache_timeline_ms = atoi(optarg);
+            cache_report = 1;
+            if (cache_timeline_ms < 1)
+            {
+                fprintf(stderr, "Sampling interval must be positive\n");
+                return -1;
+            }
+            break;
+        case 'k':
+            reps = atoi(optarg);
+            if (reps < 1)
+            {
+                fprintf(stderr, "Repetitions must be positive\n");
+                return -1;
+            }
+            break;
+        case 'B':
+            if (bench_parse_size(optarg, &matrix.stream_buf) != 0)
+                return -1;
+            break;
+        case 'j':
+            if (job_load(optarg, &jobs) != 0)
+                return -1;
+            lat_enabled = 1;
+            break;
+        case 'c':
+            if (bench_parse_size(optarg, &bcache_size) != 0)
+                return -1;
+            break;
+        case 'A':
+            if (bench_parse_size(optarg, &flusher_threshold) != 0)
+                return -1;
+            if (flusher_threshold == 0)
+            {
+                fprintf(stderr, "Flusher threshold must be positive\n");
+                return -1;
+            }
+            break;
+        case 'o':
+            if (results_open(optarg) != 0)
+                return -1;
+            break;
+        default:
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    if (lat_enabled)
+        lat_calibrate();
+    if (sys_acct_enabled)
+        sys_acct_calibrate();
+    if (perf_enabled)
+        perf_init();
+
+    bench_matrix_print_offsets(&matrix);
+
+    struct trace replay_trace = { 0 };
+    if (trace_replay_file && trace_load(trace_replay_file, &replay_trace) != 0)
+        return -1;
+
+    struct results res;
+    if (results_init(&res, reps) != 0)
+        return -1;
+
+    size_t buf_size = bench_matrix_buf_size(&matrix);
+    char *buf = bench_buf_alloc(&matrix, buf_size);
+    if (!buf)
+        return -1;
+
+    int points = bench_matrix_points(&matrix);
+    for (int i = 0; i < points; ++i)
+    {
+        bench_matrix_get(&matrix, i, &cfg);
+        if (points > 1)
+            bench_config_print(&cfg);
+        if (bench_config_check(&cfg) != 0 || bench_prepare_file(&cfg) != 0
+            || bench_offsets_generate(&cfg) != 0)
+            continue;
+        /* once the file exists, so its filesystem and device can be found */
+        if (!results_meta.date[0])
+            results_collect_meta(&results_meta, cfg.file_name);
+
+        for (int b = 0; b < NR_BACKENDS; ++b)
+        {
+            if (!selected[b])
+                continue;
+            results_reset(&res);
+            if (run_backend(backends[b], buf, trace_replay_file ? &replay_trace : NULL, &res) == 0)
+                results_report(&res, backends[b]->name, &cfg);
+
+            /* a recorded trace holds one pass of the workload, not one per backend */
+            if (trace_record_file)
+            {
+                trace_save(trace_record_file, &trace_out);
+                trace_record_file = NULL;
+            }
+        }
+    }
+
+    results_close();
+    results_free(&res);
+    bench_buf_free(&matrix, buf, buf_size);
+}
+
+/*
+ * Open the test file with `be` and run the five phases (or replay a trace)
+ * through it, `reps` times over. Returns -1 if the backend cannot run this
+ * point.
+ */
+int run_backend(const struct backend *be, char *buf, const struct trace *replay_trace,
+                struct results *res)
+{
+    printf("[%s: %s]\n", be->name, be->desc);
+
+    struct bench_file f = { .cfg = &cfg };
+    if (be->open(&f, &cfg) != 0)
+    {
+        printf("   skipped: cannot open with the %s backend\n", be->name);
+        return -1;
+    }
+
+    if (replay_trace && cfg.stream_buf && trace_max_len(replay_trace) > cfg.stream_buf)
+    {
+        printf("   skipped: trace ops of %u bytes do not fit the %zu byte stream buffer\n",
+               trace_max_len(replay_trace), cfg.stream_buf);
+        be->close(&f);
+        return -1;
+    }
+    if (replay_trace && trace_check(replay_trace, cfg.file_size) != 0)
+    {
+        be->close(&f);
+        return -1;
+    }
+
+    size_t buf_size = cfg.stream_buf ? cfg.stream_buf : cfg.file_size;
+    for (int j = 0; j < jobs.n; ++j)
+    {
+        if (job_max_bs(&jobs.v[j]) > buf_size)
+        {
+            printf("   skipped: job %s has blocks larger than the %zu byte buffer\n",
+                   jobs.v[j].name, buf_size);
+            be->close(&f);
+            return -1;
+        }
+    }
+
+    if (bcache_size && bcache_init(&bcache, bcache_size) != 0)
+    {
+        bcache_free(&bcache);
+        be->close(&f);
+        return -1;
+    }
+    if (flusher_threshold && flusher_start(f.fd) != 0)
+    {
+        bcache_free(&bcache);
+        be->close(&f);
+        return -1;
+    }
+
+    uint64_t seq_reads     = cfg.file_size / cfg.read_chunk;
+    uint64_t seq_writes    = cfg.file_size / cfg.write_chunk;
+    uint64_t random_reads  = (uint64_t)cfg.nums_random * cfg.read_chunk;
+    uint64_t random_writes = (uint64_t)cfg.nums_random * cfg.write_chunk;
+
+    for (int r = 0; r < reps; ++r)
+    {
+        if (reps > 1)
+            printf("  (run %d/%d)\n", r + 1, reps);
+
+        if (replay_trace)
+        {
+            struct trace_clock clk;
+            MEASURE_PHASE(res, 0, "Replay", trace_bytes(replay_trace), replay_trace->n,
+                          { replay(be, &f, buf, replay_trace, &clk); })
+            trace_print_summary(replay_trace, &clk);
+            continue;
+        }
+
+        for (int j = 0; j < jobs.n; ++j)
+        {
+            struct job_stats st;
+            MEASURE_PHASE(res, j, jobs.v[j].name,
+                          st.bytes[JOB_READ] + st.bytes[JOB_WRITE],
+                          st.ops[JOB_READ] + st.ops[JOB_WRITE],
+                          { run_job(be, &f, buf, &jobs.v[j], j, &st); })
+            job_print_stats(&st, res->phases[j].samples[res->phases[j].n - 1]);
+        }
+        if (jobs.n)
+            continue;
+
+        if (PHASE_ON(0))
+            MEASURE_PHASE(res, 0, "1. Sequential Read",       cfg.file_size, seq_reads,       { seq_read(be, &f, buf); })
+        if (PHASE_ON(1))
+            MEASURE_PHASE(res, 1, "2. Sequential Write",      cfg.file_size, seq_writes,      { seq_write(be, &f, buf); })
+        if (PHASE_ON(2))
+            MEASURE_PHASE(res, 2, "3. Random Read",           random_reads,  cfg.nums_random, { random_read(be, &f, buf); })
+        if (PHASE_ON(3))
+            MEASURE_PHASE(res, 3, "4. Random Buffered Write", random_writes, cfg.nums_random, { random_write_buffered(be, &f, buf); })
+        if (PHASE_ON(4))
+            MEASURE_PHASE(res, 4, "5. Random Sync Write",     random_writes, cfg.nums_random, { random_write_sync(be, &f, buf); })
+
+        /* the buffered writes again, for comparison, with durability in the background */
+        if (flusher_threshold)
+        {
+            flusher_active = 1;
+            if (PHASE_ON(5))
+                MEASURE_PHASE(res, 5, "6. Seq Write (async)",      cfg.file_size, seq_writes,      { seq_write(be, &f, buf); })
+            if (PHASE_ON(6))
+                MEASURE_PHASE(res, 6, "7. Rand Buf Write (async)", random_writes, cfg.nums_random, { random_write_buffered(be, &f, buf); })
+            flusher_active = 0;
+        }
+    }
+
+    if (bcache.nblocks)
+    {
+        bcache_writeback(&bcache, be, &f, 0, 0);
+        bcache_free(&bcache);
+    }
+    flusher_stop();
+    be->close(&f);
+    return 0;
+}
+
+/*
+ * Cold start for one phase: drop what the backend caches itself, then the
+ * file's pages in the kernel, and check with mincore() that they are gone.
+ */
+void evict_cache(const struct backend *be, struct bench_file *f)
+{
+    if (bcache.nblocks && bcache_drop(&bcache, be, f) != 0)
+        return;
+    if (be->drop && be->drop(f) != 0)
+        return;
+
+    long resident = page_cache_evict(f->fd, cfg.file_size);
+    if (resident < 0)
+        return;
+
+    long pages = (cfg.file_size + getpagesize() - 1) / getpagesize();
+    printf("Evicted %s from the page cache (%ld of %ld pages resident)\n",
+           cfg.file_name, resident, pages);
+}
+
+/*
+ * The three primitives every workload is built from. Tracing, latency
+ * recording and placing the op in the I/O buffer (which is a ring in
+ * streaming mode) happen here, once, for all backends; so does routing
+ * through the block cache when -c is given.
+ */
+static inline int io_read(const struct backend *be, struct bench_file *f,
+                          char *buf, size_t len, off_t ofs)
+{
+    TRACE(TRACE_READ, ofs, len);
+    char *p = bench_buf_at(&cfg, buf, ofs, len);
+    if (LAT(LAT_READ, bcache.nblocks ? bcache_read(&bcache, be, f, p, len, ofs)
+                                     : be->read_at(f, p, len, ofs)) != (ssize_t)len)
+    {
+        fprintf(stderr, "%s: read of %zu bytes at %lld failed\n", be->name, len, (long long)ofs);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Get writes to [ofs, ofs + len) that the block cache or the backend still
+ * hold in user space to the kernel, where sync_file_range can reach them
+ */
+static inline int io_push(const struct backend *be, struct bench_file *f, off_t ofs, size_t len)
+{
+    if (bcache.nblocks && bcache_writeback(&bcache, be, f, ofs, len) != 0)
+        return -1;
+    if (be->push && be->push(f) != 0)
+    {
+        fprintf(stderr, "%s: push to the kernel failed\n", be->name);
+        return -1;
+    }
+    return 0;
+}
+
+static inline int io_write(const struct backend *be, struct bench_file *f,
+                           const char *buf, size_t len, off_t ofs)
+{
+    TRACE(TRACE_WRITE, ofs, len);
+    const char *p = bench_buf_at(&cfg, (char *)buf, ofs, len);
+    if (LAT(LAT_WRITE, bcache.nblocks ? bcache_write(&bcache, be, f, p, len, ofs)
+                                      : be->write_at(f, p, len, ofs)) != (ssize_t)len)
+    {
+        fprintf(stderr, "%s: write of %zu bytes at %lld failed\n", be->name, len, (long long)ofs);
+        return -1;
+    }
+    if (flusher_dirty(ofs, len))
+    {
+        if (io_push(be, f, flusher.lo, flusher.hi - flusher.lo) != 0)
+            return -1;
+        flusher_post();
+    }
+    return 0;
+}
+
+/*
+ * Flush through the block cache, if any. With -A a full-file flush is timed
+ * for the flusher report and, in an async phase, first waits for the
+ * flusher to catch up.
+ */
+static inline int io_flush_now(const struct backend *be, struct bench_file *f, off_t ofs, size_t len)
+{
+    if (bcache.nblocks && bcache_writeback(&bcache, be, f, ofs, len) != 0)
+        return -1;
+    if (!flusher_threshold || len != 0)
+        return be->flush(f, ofs, len);
+
+    if (flusher_active)
+    {
+        if (io_push(be, f, 0, 0) != 0)
+            return -1;
+        flusher_fence();
+    }
+    uint64_t t0 = lat_now();
+    int ret = be->flush(f, ofs, len);
+    flusher.st.flush_ns += lat_now() - t0;
+    return ret;
+}
+
+static inline int io_flush(const struct backend *be, struct bench_file *f, off_t ofs, size_t len)
+{
+    TRACE(TRACE_SYNC, ofs, len);
+    if (LAT(LAT_SYNC, io_flush_now(be, f, ofs, len)) != 0)
+    {
+        fprintf(stderr, "%s: flush failed\n", be->name);
+        return -1;
+    }
+    return 0;
+}
+
+int seq_read(const struct backend *be, struct bench_file *f, char *buf)
+{
+    for (size_t ofs = 0; ofs < cfg.file_size; ofs += cfg.read_chunk)
+        if (io_read(be, f, buf, cfg.read_chunk, ofs) != 0)
+            return -1;
+    return 0;
+}
+
+int seq_write(const struct backend *be, struct bench_file *f, const char *buf)
+{
+    for (size_t ofs = 0; ofs < cfg.file_size; ofs += cfg.write_chunk)
+        if (io_write(be, f, buf, cfg.write_chunk, ofs) != 0)
+            return -1;
+    return io_flush(be, f, 0, 0);
+}
+
+int random_read(const struct backend *be, struct bench_file *f, char *buf)
+{
+    for (int i = 0; i < cfg.nums_random; ++i)
+    {
+        off_t ofs = bench_offsets[OFS_READ][i];
+        if (io_read(be, f, buf, cfg.read_chunk, ofs) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+int random_write_buffered(const struct backend *be, struct bench_file *f, const char *buf)
+{
+    for (int i = 0; i < cfg.nums_random; ++i)
+    {
+        off_t ofs = bench_offsets[OFS_WRITE][i];
+        if (io_write(be, f, buf, cfg.write_chunk, ofs) != 0)
+            return -1;
+    }
+    return io_flush(be, f, 0, 0);
+}
+
+int random_write_sync(const struct backend *be, struct bench_file *f, const char *buf)
+{
+    for (int i = 0; i < cfg.nums_random; ++i)
+    {
+        off_t ofs = bench_offsets[OFS_WRITE_SYNC][i];
+        if (io_write(be, f, buf, cfg.write_chunk, ofs) != 0
+            || io_flush(be, f, ofs, cfg.write_chunk) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+int replay(const struct backend *be, struct bench_file *f, char *buf,
+           const struct trace *t, struct trace_clock *clk)
+{
+    trace_clock_start(clk);
+    for (size_t i = 0; i < t->n; ++i)
+    {
+        const struct trace_rec *r = &t->recs[i];
+        trace_wait(clk, r);
+
+        int ret = 0;
+        switch (r->op)
+        {
+        case TRACE_READ:
+            ret = io_read(be, f, buf, r->length, r->offset);
+            break;
+        case TRACE_WRITE:
+            ret = io_write(be, f, buf, r->length, r->offset);
+            break;
+        case TRACE_SYNC:
+            ret = io_flush(be, f, r->offset, r->length);
+            break;
+        }
+        if (ret != 0)
+            return -1;
+    }
+    return 0;
+}
+
+/*
+ * Run job `j` (number `idx` of the job file) until its op count, runtime
+ * or byte budget is used up. Op types, block sizes and offsets are drawn
+ * from a generator seeded like the random phases, so every backend runs the
+ * same sequence. Rate caps are kept on an absolute schedule; think time is
+ * added on top.
+ */
+int run_job(const struct backend *be, struct bench_file *f, char *buf,
+            const struct job *j, int idx, struct job_stats *st)
+{
+    struct pcg32 g;
+    pcg32_seed(&g, cfg.seed, OFS_NR + idx);
+    memset(st, 0, sizeof(*st));
+
+    uint64_t budget = j->runtime_ns || j->number_ios ? 0 : cfg.file_size;
+    uint64_t start = lat_now();
+    uint64_t due = start;
+    off_t seq_ofs = 0;
+
+    for (uint64_t i = 0; ; ++i)
+    {
+        if ((j->number_ios && i >= j->number_ios)
+            || (j->runtime_ns && lat_now() - start >= j->runtime_ns)
+            || (budget && st->bytes[JOB_READ] + st->bytes[JOB_WRITE] >= budget))
+            break;
+
+        size_t len = job_pick_bs(j, &g);
+        int dir = pcg32_bounded(&g, 100) < j->read_pct ? JOB_READ : JOB_WRITE;
+
+        off_t ofs;
+        if (j->random)
+            ofs = (off_t)pcg32_bounded(&g, cfg.file_size / len) * len;
+        else
+        {
+            if ((size_t)seq_ofs + len > cfg.file_size)
+                seq_ofs = 0;
+            ofs = seq_ofs;
+            seq_ofs += len;
+        }
+
+        if (j->rate_iops || j->rate_bytes)
+        {
+            uint64_t now = lat_now();
+            if (now < due)
+                job_sleep_until(due);
+            else if (now - due > 1000)
+                st->late++;
+            due += job_interval(j, len);
+        }
+
+        int ret = dir == JOB_READ ? io_read(be, f, buf, len, ofs) : io_write(be, f, buf, len, ofs);
+        if (ret != 0)
+            return -1;
+        st->ops[dir]++;
+        st->bytes[dir] += len;
+
+        if (dir == JOB_WRITE && j->fsync_every && st->ops[JOB_WRITE] % j->fsync_every == 0)
+        {
+            if (io_flush(be, f, 0, 0) != 0)
+                return -1;
+            st->flushes++;
+        }
+
+        if (j->think_ns && (i + 1) % j->think_blocks == 0)
+        {
+            job_sleep_until(lat_now() + j->think_ns);
+            due += j->think_ns;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,436 @@
+#ifndef BENCH_CONFIG_H
+#define BENCH_CONFIG_H
+
+/*
+ * Runtime workload parameters shared by the hw1 benchmarks.
+ *
+ * Every parameter takes a comma separated list ("4K,16K,64K") or a
+ * doubling range ("512:1M"); the program runs the cartesian product of
+ * all lists. With the defaults there is a single point, identical to the
+ * old FILE_SIZE_MB / READ_CHUNK_SIZE / WRITE_CHUNK_SIZE / 50000 macros.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#include "offset_gen.h"
+#include "file_gen.h"
+#include "huge_buf.h"
+#include "parse_num.h"
+
+#define BENCH_FILE_NAME         "100MB.bin"
+#define BENCH_FILE_SIZE         (100 * 1024 * 1024)
+#define BENCH_READ_CHUNK        4096
+#define BENCH_WRITE_CHUNK       2048
+#define BENCH_RANDOM_OPS        50000
+
+#define BENCH_PAGE_SIZE         4096
+#define BENCH_MAX_LIST          32
+
+/* getopt() letters and usage text, to be merged into each program's own */
+#define BENCH_MATRIX_OPTS       "F:s:R:W:n:D:S:H:"
+#define BENCH_MATRIX_USAGE                                                      \
+    "  -F file    test file (default " BENCH_FILE_NAME ")\n"                    \
+    "  -s sizes   file sizes, e.g. 64M,100M or 16M:1G (default 100M)\n"         \
+    "  -R sizes   read chunk sizes (default 4K)\n"                              \
+    "  -W sizes   write chunk sizes (default 2K)\n"                             \
+    "  -n counts  ops per random phase (default 50000)\n"                       \
+    "  -D dist    random offsets: uniform (default), zipf:THETA,\n"             \
+    "             hotspot:OPS:SPACE (OPS%% of ops hit SPACE%% of the file)\n"   \
+    "             or stride:SIZE\n"                                             \
+    "  -S seed    offset generator seed (default: time based)\n"                \
+    "  -H pages   I/O buffer on 4k (default), thp or hugetlb pages; thp and\n"  \
+    "             hugetlb also advise file mappings to use huge pages\n"
+
+struct bench_list {
+    size_t v[BENCH_MAX_LIST];
+    int n;
+};
+
+struct bench_matrix {
+    const char *file_name;
+    struct bench_list file_sizes;
+    struct bench_list read_chunks;
+    struct bench_list write_chunks;
+    struct bench_list random_ops;
+    struct offset_dist dist;
+    uint64_t seed;
+    int seed_set;
+    size_t stream_buf;
+    enum huge_mode huge;
+};
+
+/* One point of the matrix */
+struct bench_config {
+    const char *file_name;
+    size_t file_size;
+    size_t read_chunk;
+    size_t write_chunk;
+    int nums_random;
+    struct offset_dist dist;
+    uint64_t seed;
+    size_t stream_buf;      /* streaming: ring buffer size; 0: one buffer per file byte */
+    enum huge_mode huge;    /* page size asked for the buffer and mappings */
+};
+
+/* Offsets of the three random phases, see bench_offsets_generate() */
+enum bench_ofs { OFS_READ, OFS_WRITE, OFS_WRITE_SYNC, OFS_NR };
+
+static off_t *bench_offsets[OFS_NR];
+static int bench_offsets_cap;
+
+/* A size that may be followed by the next element of a list or range */
+static int bench_parse_size(const char *s, size_t *out)
+{
+    return parse_size_sep(s, out, ",:");
+}
+
+static int bench_list_add(struct bench_list *l, size_t v)
+{
+    if (l->n == BENCH_MAX_LIST)
+    {
+        fprintf(stderr, "At most %d values per list\n", BENCH_MAX_LIST);
+        return -1;
+    }
+    l->v[l->n++] = v;
+    return 0;
+}
+
+/* Parse "a,b,c" or a doubling range "lo:hi" into `l`, replacing its contents */
+static int bench_parse_list(struct bench_list *l, const char *arg)
+{
+    l->n = 0;
+
+    const char *colon = strchr(arg, ':');
+    if (colon)
+    {
+        size_t lo, hi;
+        if (bench_parse_size(arg, &lo) != 0 || bench_parse_size(colon + 1, &hi) != 0)
+            return -1;
+        for (size_t v = lo; v <= hi; v <<= 1)
+            if (bench_list_add(l, v) != 0)
+                return -1;
+        return 0;
+    }
+
+    const char *p = arg;
+    while (1)
+    {
+        size_t v;
+        if (bench_parse_size(p, &v) != 0 || bench_list_add(l, v) != 0)
+            return -1;
+        if (!(p = strchr(p, ',')))
+            return 0;
+        p++;
+    }
+}
+
+/* Parse a -D spec: "uniform", "zipf:0.99", "hotspot:90:10" or "stride:64K" */
+static int bench_parse_dist(struct offset_dist *d, const char *arg)
+{
+    memset(d, 0, sizeof(*d));
+
+    const char *param = strchr(arg, ':');
+    size_t len = param ? (size_t)(param - arg) : strlen(arg);
+    char *end = NULL;
+
+    if (strncmp(arg, "uniform", len) == 0 && len == 7 && !param)
+    {
+        d->kind = DIST_UNIFORM;
+        return 0;
+    }
+    if (strncmp(arg, "zipf", len) == 0 && len == 4)
+    {
+        d->kind = DIST_ZIPF;
+        d->theta = param ? strtod(param + 1, &end) : 0.99;
+        if ((!param || (*end == '\0' && end != param + 1)) && d->theta > 0)
+            return 0;
+    }
+    else if (strncmp(arg, "hotspot", len) == 0 && len == 7 && param)
+    {
+        d->kind = DIST_HOTSPOT;
+        d->hot_ops = strtod(param + 1, &end);
+        if (*end == ':')
+        {
+            const char *space = end + 1;
+            d->hot_space = strtod(space, &end);
+            if (*end == '\0' && end != space
+                && d->hot_ops >= 0 && d->hot_ops <= 100
+                && d->hot_space > 0 && d->hot_space <= 100)
+                return 0;
+        }
+    }
+    else if (strncmp(arg, "stride", len) == 0 && len == 6 && param)
+    {
+        d->kind = DIST_STRIDE;
+        return bench_parse_size(param + 1, &d->stride);
+    }
+
+    fprintf(stderr, "Invalid distribution '%s'\n", arg);
+    return -1;
+}
+
+static void bench_matrix_init(struct bench_matrix *m)
+{
+    memset(m, 0, sizeof(*m));
+    m->file_name = BENCH_FILE_NAME;
+    bench_list_add(&m->file_sizes, BENCH_FILE_SIZE);
+    bench_list_add(&m->read_chunks, BENCH_READ_CHUNK);
+    bench_list_add(&m->write_chunks, BENCH_WRITE_CHUNK);
+    bench_list_add(&m->random_ops, BENCH_RANDOM_OPS);
+    m->dist.kind = DIST_UNIFORM;
+    m->seed = (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 32);
+}
+
+/*
+ * Handle one of the BENCH_MATRIX_OPTS letters. Returns 1 if `opt` was
+ * consumed, 0 if it belongs to the caller and -1 on a bad argument.
+ */
+static int bench_matrix_option(struct bench_matrix *m, int opt, const char *arg)
+{
+    switch (opt)
+    {
+    case 'F':
+        m->file_name = arg;
+        return 1;
+    case 's':
+        return bench_parse_list(&m->file_sizes, arg) == 0 ? 1 : -1;
+    case 'R':
+        return bench_parse_list(&m->read_chunks, arg) == 0 ? 1 : -1;
+    case 'W':
+        return bench_parse_list(&m->write_chunks, arg) == 0 ? 1 : -1;
+    case 'n':
+        return bench_parse_list(&m->random_ops, arg) == 0 ? 1 : -1;
+    case 'D':
+        return bench_parse_dist(&m->dist, arg) == 0 ? 1 : -1;
+    case 'S':
+        if (parse_seed(arg, &m->seed) != 0)
+            return -1;
+        m->seed_set = 1;
+        return 1;
+    case 'H':
+        for (int i = 0; i < HUGE_NR_MODES; ++i)
+        {
+            if (strcmp(arg, huge_mode_names[i]) == 0)
+            {
+                m->huge = i;
+                return 1;
+            }
+        }
+        fprintf(stderr, "Unknown page mode '%s'\n", arg);
+        return -1;
+    }
+    return 0;
+}
+
+static int bench_matrix_points(const struct bench_matrix *m)
+{
+    return m->file_sizes.n * m->read_chunks.n * m->write_chunks.n * m->random_ops.n;
+}
+
+static size_t bench_matrix_max_file_size(const struct bench_matrix *m)
+{
+    size_t max = 0;
+    for (int i = 0; i < m->file_sizes.n; ++i)
+        if (m->file_sizes.v[i] > max)
+            max = m->file_sizes.v[i];
+    return max;
+}
+
+/* Size of the I/O buffer: the largest file, or the ring in streaming mode */
+static inline size_t bench_matrix_buf_size(const struct bench_matrix *m)
+{
+    return m->stream_buf ? m->stream_buf : bench_matrix_max_file_size(m);
+}
+
+/*
+ * Allocate the I/O buffer of `size` bytes on the pages -H asked for, filled
+ * so every page is faulted in before the first phase. A hugetlb request
+ * that falls back to thp is recorded in `m`. NULL on failure.
+ */
+static inline char *bench_buf_alloc(struct bench_matrix *m, size_t size)
+{
+    char *buf = huge_alloc(size, &m->huge);
+    if (!buf)
+        return NULL;
+    memset(buf, 'X', size);
+    if (m->huge != HUGE_NONE)
+        huge_report("buffer", buf, size);
+    return buf;
+}
+
+static inline void bench_buf_free(const struct bench_matrix *m, char *buf, size_t size)
+{
+    huge_free(buf, size, m->huge);
+}
+
+/* Fill `cfg` with point `idx` (0 .. bench_matrix_points() - 1) */
+static void bench_matrix_get(const struct bench_matrix *m, int idx, struct bench_config *cfg)
+{
+    cfg->file_name = m->file_name;
+    cfg->dist = m->dist;
+    cfg->seed = m->seed;
+    cfg->stream_buf = m->stream_buf;
+    cfg->huge = m->huge;
+    cfg->nums_random = m->random_ops.v[idx % m->random_ops.n];
+    idx /= m->random_ops.n;
+    cfg->write_chunk = m->write_chunks.v[idx % m->write_chunks.n];
+    idx /= m->write_chunks.n;
+    cfg->read_chunk = m->read_chunks.v[idx % m->read_chunks.n];
+    idx /= m->read_chunks.n;
+    cfg->file_size = m->file_sizes.v[idx];
+}
+
+/* Granularity of the random offsets: a page, or the larger chunk */
+static inline size_t bench_slot_size(const struct bench_config *cfg)
+{
+    size_t slot = cfg->read_chunk > cfg->write_chunk ? cfg->read_chunk : cfg->write_chunk;
+    return slot < BENCH_PAGE_SIZE ? BENCH_PAGE_SIZE : slot;
+}
+
+/*
+ * Reject points the workloads cannot run: every phase moves whole chunks
+ * and the random phases place them on page or chunk boundaries. A stream
+ * ring must hold whole slots, so that no op wraps around its end.
+ */
+static int bench_config_check(const struct bench_config *cfg)
+{
+    if (cfg->file_size % BENCH_PAGE_SIZE != 0
+        || cfg->file_size % cfg->read_chunk != 0
+        || cfg->file_size % cfg->write_chunk != 0)
+    {
+        printf("   skipped: file size %zu is not a multiple of the page and chunk sizes\n",
+               cfg->file_size);
+        return -1;
+    }
+    if (cfg->stream_buf && cfg->stream_buf % bench_slot_size(cfg) != 0)
+    {
+        printf("   skipped: stream buffer %zu is not a multiple of %zu\n",
+               cfg->stream_buf, bench_slot_size(cfg));
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Where in `buf` the op on [ofs, ofs + len) of the file keeps its data.
+ * Normally the buffer mirrors the file; in streaming mode it is a ring that
+ * the file is folded onto, so memory stays fixed however large the file.
+ */
+static inline char *bench_buf_at(const struct bench_config *cfg, char *buf, off_t ofs, size_t len)
+{
+    if (!cfg->stream_buf)
+        return buf + ofs;
+
+    size_t at = ofs % cfg->stream_buf;
+    return at + len <= cfg->stream_buf ? buf + at : buf;
+}
+
+/* Report the offset distribution and seed when they were chosen explicitly */
+static void bench_matrix_print_offsets(const struct bench_matrix *m)
+{
+    if (m->dist.kind == DIST_UNIFORM && !m->seed_set)
+        return;
+
+    printf("Offsets: %s", offset_dist_names[m->dist.kind]);
+    if (m->dist.kind == DIST_ZIPF)
+        printf(" theta=%.2f", m->dist.theta);
+    else if (m->dist.kind == DIST_HOTSPOT)
+        printf(" %.1f%% of ops on %.1f%% of the file", m->dist.hot_ops, m->dist.hot_space);
+    else if (m->dist.kind == DIST_STRIDE)
+        printf(" %zu bytes", m->dist.stride);
+    printf(", seed %llu\n", (unsigned long long)m->seed);
+}
+
+static void bench_config_print(const struct bench_config *cfg)
+{
+    printf("[file=%zuMB read=%zu write=%zu ops=%d]\n", cfg->file_size >> 20,
+           cfg->read_chunk, cfg->write_chunk, cfg->nums_random);
+}
+
+/*
+ * Make the test file exactly `cfg->file_size` bytes, creating it if needed.
+ * Missing data is generated in parallel (file_gen.h) from the seed rather
+ * than left as a hole, so reads of the tail really hit the device. Uses its
+ * own buffered descriptor, so it works while the benchmark holds the file
+ * open with O_DIRECT or stdio.
+ */
+static int bench_prepare_file(const struct bench_config *cfg)
+{
+    int fd = open(cfg->file_name, O_RDWR | O_CREAT, 0644);
+    if (fd == -1)
+    {
+        perror("open");
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        perror("fstat");
+        close(fd);
+        return -1;
+    }
+
+    if ((size_t)st.st_size >= cfg->file_size)
+    {
+        int ret = ftruncate(fd, cfg->file_size);
+        if (ret != 0)
+            perror("ftruncate");
+        close(fd);
+        return ret;
+    }
+
+    if (file_gen_fill(fd, st.st_size, cfg->file_size, cfg->seed, FILE_GEN_PWRITE,
+                      file_gen_default_threads()) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    close(fd);
+
+    printf("   extended %s from %lld to %zu bytes\n", cfg->file_name,
+           (long long)st.st_size, cfg->file_size);
+    return 0;
+}
+
+/*
+ * Precompute the offsets of the three random phases into bench_offsets[],
+ * outside any timed region. Chunks up to a page are placed on page
+ * boundaries, larger ones on chunk boundaries so they stay inside the file.
+ * Each phase draws its own stream, so for a given seed every backend sees
+ * the same sequence. Call again whenever the chunk sizes or op count change.
+ */
+static int bench_offsets_generate(const struct bench_config *cfg)
+{
+    if (cfg->nums_random > bench_offsets_cap)
+    {
+        for (int p = 0; p < OFS_NR; ++p)
+        {
+            off_t *ofs = realloc(bench_offsets[p], cfg->nums_random * sizeof(off_t));
+            if (!ofs)
+            {
+                perror("realloc");
+                return -1;
+            }
+            bench_offsets[p] = ofs;
+        }
+        bench_offsets_cap = cfg->nums_random;
+    }
+
+    size_t slot = bench_slot_size(cfg);
+    for (int p = 0; p < OFS_NR; ++p)
+        offset_gen_fill(bench_offsets[p], cfg->nums_random, &cfg->dist, cfg->seed, p,
+                        cfg->file_size / slot, slot);
+    return 0;
+}
+
+#endif
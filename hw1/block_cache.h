@@ -0,0 +1,469 @@
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+/*
+ * User-space write-back block cache for the benchmark engine, sitting
+ * between the workloads and a backend.
+ *
+ * The file is cached in page-sized blocks, evicted by CLOCK (second
+ * chance). Writes only mark the bytes they cover as dirty: a 2K write to
+ * an uncached page does not read the page first, the rest of it is filled
+ * in only if something later reads it. At flush time the dirty blocks are
+ * sorted by file offset and adjacent dirty ranges are coalesced into
+ * writes of up to BCACHE_MAX_WRITE bytes, so scattered small writes reach
+ * the backend as few large ones. A dirty block evicted early is written
+ * back with the dirty run it belongs to.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "backend.h"
+
+#define BCACHE_BLOCK        4096
+#define BCACHE_MAX_WRITE    (1 << 20)
+
+struct bcache_block {
+    off_t blkno;            /* -1 when the slot is free */
+    int next;               /* hash chain */
+    uint16_t lo, hi;        /* dirty bytes [lo, hi); lo == hi when clean */
+    uint8_t valid;          /* the whole block holds file data */
+    uint8_t ref;            /* CLOCK reference bit */
+};
+
+struct bcache_stats {
+    uint64_t read_ops, read_hits;
+    uint64_t write_ops, write_hits;
+    uint64_t app_read_bytes, app_write_bytes;
+    uint64_t issued_reads, issued_read_bytes;
+    uint64_t issued_writes, issued_write_bytes;
+    uint64_t evictions, dirty_evictions;
+};
+
+struct bcache {
+    size_t nblocks;
+    char *data;
+    struct bcache_block *blocks;
+    int *hash;
+    size_t hash_size;
+    size_t hand;
+    char *stage;            /* coalescing buffer, BCACHE_MAX_WRITE bytes */
+    char *fill;             /* read buffer for misses, as large */
+    int *sorted;            /* scratch for write-back order */
+    struct bcache_stats st;
+};
+
+static int bcache_init(struct bcache *c, size_t size)
+{
+    memset(c, 0, sizeof(*c));
+    c->nblocks = size / BCACHE_BLOCK;
+    if (c->nblocks == 0)
+    {
+        fprintf(stderr, "Block cache must hold at least one %d byte block\n", BCACHE_BLOCK);
+        return -1;
+    }
+    c->hash_size = 1;
+    while (c->hash_size < c->nblocks)
+        c->hash_size <<= 1;
+
+    c->blocks = malloc(c->nblocks * sizeof(*c->blocks));
+    c->hash = malloc(c->hash_size * sizeof(*c->hash));
+    c->sorted = malloc(c->nblocks * sizeof(*c->sorted));
+    /* page aligned, so the direct backend can write from it */
+    if (!c->blocks || !c->hash || !c->sorted
+        || posix_memalign((void **)&c->data, 4096, c->nblocks * BCACHE_BLOCK) != 0
+        || posix_memalign((void **)&c->stage, 4096, BCACHE_MAX_WRITE) != 0
+        || posix_memalign((void **)&c->fill, 4096, BCACHE_MAX_WRITE) != 0)
+    {
+        perror("block cache");
+        return -1;
+    }
+
+    for (size_t i = 0; i < c->nblocks; ++i)
+        c->blocks[i].blkno = -1;
+    for (size_t i = 0; i < c->hash_size; ++i)
+        c->hash[i] = -1;
+    return 0;
+}
+
+static void bcache_free(struct bcache *c)
+{
+    free(c->blocks);
+    free(c->hash);
+    free(c->sorted);
+    free(c->data);
+    free(c->stage);
+    free(c->fill);
+    memset(c, 0, sizeof(*c));
+}
+
+static inline size_t bcache_bucket(const struct bcache *c, off_t blkno)
+{
+    return ((uint64_t)blkno * 0x9e3779b97f4a7c15ull) >> 32 & (c->hash_size - 1);
+}
+
+static inline int bcache_lookup(const struct bcache *c, off_t blkno)
+{
+    for (int i = c->hash[bcache_bucket(c, blkno)]; i != -1; i = c->blocks[i].next)
+        if (c->blocks[i].blkno == blkno)
+            return i;
+    return -1;
+}
+
+static inline char *bcache_data(const struct bcache *c, int i)
+{
+    return c->data + (size_t)i * BCACHE_BLOCK;
+}
+
+static int bcache_issue_write(struct bcache *c, const struct backend *be, struct bench_file *f,
+                              const char *buf, size_t len, off_t ofs)
+{
+    if (be->write_at(f, buf, len, ofs) != (ssize_t)len)
+    {
+        fprintf(stderr, "%s: cache write-back of %zu bytes at %lld failed\n",
+                be->name, len, (long long)ofs);
+        return -1;
+    }
+    c->st.issued_writes++;
+    c->st.issued_write_bytes += len;
+    return 0;
+}
+
+/*
+ * Write back the dirty bytes of block `i` together with the dirty bytes
+ * that continue them in the following cached blocks, up to
+ * BCACHE_MAX_WRITE, as one write.
+ */
+static int bcache_write_run(struct bcache *c, const struct backend *be, struct bench_file *f,
+                            int i)
+{
+    struct bcache_block *b = &c->blocks[i];
+    off_t start = b->blkno * BCACHE_BLOCK + b->lo;
+    size_t run = b->hi - b->lo;
+    memcpy(c->stage, bcache_data(c, i) + b->lo, run);
+    b->lo = b->hi = 0;
+
+    for (off_t next = b->blkno + 1; start + (off_t)run == next * BCACHE_BLOCK; ++next)
+    {
+        int j = bcache_lookup(c, next);
+        if (j == -1)
+            break;
+        struct bcache_block *nb = &c->blocks[j];
+        if (nb->lo != 0 || nb->hi == 0 || run + nb->hi > BCACHE_MAX_WRITE)
+            break;
+        memcpy(c->stage + run, bcache_data(c, j), nb->hi);
+        run += nb->hi;
+        nb->lo = nb->hi = 0;
+    }
+
+    return bcache_issue_write(c, be, f, c->stage, run, start);
+}
+
+/*
+ * Write back dirty block `i` before evicting it. Like kernel writeback, the
+ * write is clustered: it starts at the beginning of the dirty run `i` sits
+ * in, so a sequential writer's blocks leave in large writes.
+ */
+static int bcache_write_victim(struct bcache *c, const struct backend *be, struct bench_file *f,
+                               int i)
+{
+    for (int back = 1; back < BCACHE_MAX_WRITE / BCACHE_BLOCK; ++back)
+    {
+        if (c->blocks[i].lo != 0)
+            break;
+        int p = bcache_lookup(c, c->blocks[i].blkno - 1);
+        if (p == -1 || c->blocks[p].hi != BCACHE_BLOCK)
+            break;
+        i = p;
+    }
+    return bcache_write_run(c, be, f, i);
+}
+
+/* Take slot `i` out of its hash chain and mark it free */
+static void bcache_unlink(struct bcache *c, int i)
+{
+    int *p = &c->hash[bcache_bucket(c, c->blocks[i].blkno)];
+    while (*p != i)
+        p = &c->blocks[*p].next;
+    *p = c->blocks[i].next;
+    c->blocks[i].blkno = -1;
+}
+
+/* CLOCK: find a slot for `blkno`, writing back the victim if it is dirty */
+static int bcache_alloc(struct bcache *c, const struct backend *be, struct bench_file *f,
+                        off_t blkno)
+{
+    int i;
+    while (1)
+    {
+        i = c->hand;
+        c->hand = (c->hand + 1) % c->nblocks;
+
+        struct bcache_block *b = &c->blocks[i];
+        if (b->blkno == -1)
+            break;
+        if (b->ref)
+        {
+            b->ref = 0;
+            continue;
+        }
+
+        c->st.evictions++;
+        if (b->lo != b->hi)
+        {
+            c->st.dirty_evictions++;
+            if (bcache_write_victim(c, be, f, i) != 0)
+                return -1;
+        }
+        bcache_unlink(c, i);
+        break;
+    }
+
+    struct bcache_block *b = &c->blocks[i];
+    size_t h = bcache_bucket(c, blkno);
+    b->blkno = blkno;
+    b->next = c->hash[h];
+    b->lo = b->hi = 0;
+    b->valid = 0;
+    b->ref = 1;
+    c->hash[h] = i;
+    return i;
+}
+
+/* Read block `i` from the backend, keeping the bytes that are dirty */
+static int bcache_fill(struct bcache *c, const struct backend *be, struct bench_file *f, int i)
+{
+    struct bcache_block *b = &c->blocks[i];
+    char *data = bcache_data(c, i);
+    off_t ofs = b->blkno * BCACHE_BLOCK;
+
+    /* with nothing dirty, read in place; otherwise merge from the side */
+    char *dst = b->lo == b->hi ? data : c->fill;
+    if (be->read_at(f, dst, BCACHE_BLOCK, ofs) != BCACHE_BLOCK)
+    {
+        fprintf(stderr, "%s: cache fill at %lld failed\n", be->name, (long long)ofs);
+        return -1;
+    }
+    c->st.issued_reads++;
+    c->st.issued_read_bytes += BCACHE_BLOCK;
+
+    if (dst != data)
+    {
+        memcpy(data, dst, b->lo);
+        memcpy(data + b->hi, dst + b->hi, BCACHE_BLOCK - b->hi);
+    }
+    b->valid = 1;
+    return 0;
+}
+
+/* Cache `m` missing blocks from `blkno` on with a single backend read */
+static int bcache_fill_run(struct bcache *c, const struct backend *be, struct bench_file *f,
+                           off_t blkno, int m)
+{
+    off_t ofs = blkno * BCACHE_BLOCK;
+    size_t len = (size_t)m * BCACHE_BLOCK;
+    if (be->read_at(f, c->fill, len, ofs) != (ssize_t)len)
+    {
+        fprintf(stderr, "%s: cache fill of %zu bytes at %lld failed\n", be->name, len, (long long)ofs);
+        return -1;
+    }
+    c->st.issued_reads++;
+    c->st.issued_read_bytes += len;
+
+    for (int j = 0; j < m; ++j)
+    {
+        int i = bcache_alloc(c, be, f, blkno + j);
+        if (i < 0)
+            return -1;
+        memcpy(bcache_data(c, i), c->fill + (size_t)j * BCACHE_BLOCK, BCACHE_BLOCK);
+        c->blocks[i].valid = 1;
+    }
+    return 0;
+}
+
+static ssize_t bcache_read(struct bcache *c, const struct backend *be, struct bench_file *f,
+                           char *buf, size_t len, off_t ofs)
+{
+    c->st.read_ops++;
+    c->st.app_read_bytes += len;
+
+    int hit = 1;
+    for (size_t done = 0; done < len; )
+    {
+        off_t blkno = (ofs + done) / BCACHE_BLOCK;
+        size_t in = (ofs + done) % BCACHE_BLOCK;
+        size_t n = BCACHE_BLOCK - in < len - done ? BCACHE_BLOCK - in : len - done;
+
+        int i = bcache_lookup(c, blkno);
+        if (i == -1)
+        {
+            /*
+             * Read the following blocks of the op that are missing too. The
+             * run is kept well under the cache size so that allocating its
+             * last block cannot evict its first.
+             */
+            off_t last = (ofs + len - 1) / BCACHE_BLOCK;
+            int max = BCACHE_MAX_WRITE / BCACHE_BLOCK;
+            if ((size_t)max > c->nblocks / 4)
+                max = c->nblocks / 4 ? c->nblocks / 4 : 1;
+            int m = 1;
+            while (blkno + m <= last && m < max && bcache_lookup(c, blkno + m) == -1)
+                m++;
+
+            hit = 0;
+            if (bcache_fill_run(c, be, f, blkno, m) != 0)
+                return -1;
+            if ((i = bcache_lookup(c, blkno)) == -1)
+                continue;
+        }
+        else
+        {
+            struct bcache_block *b = &c->blocks[i];
+            b->ref = 1;
+            if (!b->valid && !(in >= b->lo && in + n <= b->hi))
+            {
+                hit = 0;
+                if (bcache_fill(c, be, f, i) != 0)
+                    return -1;
+            }
+        }
+
+        memcpy(buf + done, bcache_data(c, i) + in, n);
+        done += n;
+    }
+
+    c->st.read_hits += hit;
+    return len;
+}
+
+static ssize_t bcache_write(struct bcache *c, const struct backend *be, struct bench_file *f,
+                            const char *buf, size_t len, off_t ofs)
+{
+    c->st.write_ops++;
+    c->st.app_write_bytes += len;
+
+    int hit = 1;
+    for (size_t done = 0; done < len; )
+    {
+        off_t blkno = (ofs + done) / BCACHE_BLOCK;
+        size_t in = (ofs + done) % BCACHE_BLOCK;
+        size_t n = BCACHE_BLOCK - in < len - done ? BCACHE_BLOCK - in : len - done;
+
+        int i = bcache_lookup(c, blkno);
+        if (i == -1)
+        {
+            hit = 0;
+            if ((i = bcache_alloc(c, be, f, blkno)) < 0)
+                return -1;
+        }
+
+        struct bcache_block *b = &c->blocks[i];
+        b->ref = 1;
+
+        /* the dirty range must stay one piece: fill a gap from the file first */
+        if (b->lo != b->hi && !b->valid && (in > b->hi || in + n < b->lo))
+        {
+            hit = 0;
+            if (bcache_fill(c, be, f, i) != 0)
+                return -1;
+        }
+        memcpy(bcache_data(c, i) + in, buf + done, n);
+
+        if (b->lo == b->hi)
+        {
+            b->lo = in;
+            b->hi = in + n;
+        }
+        else
+        {
+            if (in < b->lo)
+                b->lo = in;
+            if (in + n > b->hi)
+                b->hi = in + n;
+        }
+        if (b->lo == 0 && b->hi == BCACHE_BLOCK)
+            b->valid = 1;
+        done += n;
+    }
+
+    c->st.write_hits += hit;
+    return len;
+}
+
+static int bcache_cmp(const void *a, const void *b, void *arg)
+{
+    const struct bcache *c = arg;
+    off_t x = c->blocks[*(const int *)a].blkno;
+    off_t y = c->blocks[*(const int *)b].blkno;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Write back the dirty blocks overlapping [ofs, ofs + len) (everything when
+ * `len` is 0) in file order, merging runs of adjacent dirty bytes.
+ */
+static int bcache_writeback(struct bcache *c, const struct backend *be, struct bench_file *f,
+                            off_t ofs, size_t len)
+{
+    off_t first = ofs / BCACHE_BLOCK;
+    off_t last = len ? (off_t)((ofs + len - 1) / BCACHE_BLOCK) : -1;
+
+    int n = 0;
+    for (size_t i = 0; i < c->nblocks; ++i)
+    {
+        const struct bcache_block *b = &c->blocks[i];
+        if (b->blkno != -1 && b->lo != b->hi
+            && (!len || (b->blkno >= first && b->blkno <= last)))
+            c->sorted[n++] = i;
+    }
+    qsort_r(c->sorted, n, sizeof(*c->sorted), bcache_cmp, c);
+
+    /* in file order every run starts at the first of its blocks */
+    for (int k = 0; k < n; ++k)
+    {
+        const struct bcache_block *b = &c->blocks[c->sorted[k]];
+        if (b->lo != b->hi && bcache_write_run(c, be, f, c->sorted[k]) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+/* Write back everything and forget the contents, e.g. before a cold phase */
+static int bcache_drop(struct bcache *c, const struct backend *be, struct bench_file *f)
+{
+    if (bcache_writeback(c, be, f, 0, 0) != 0)
+        return -1;
+    for (size_t i = 0; i < c->nblocks; ++i)
+        c->blocks[i].blkno = -1;
+    for (size_t i = 0; i < c->hash_size; ++i)
+        c->hash[i] = -1;
+    return 0;
+}
+
+static inline void bcache_phase_begin(struct bcache *c)
+{
+    memset(&c->st, 0, sizeof(c->st));
+}
+
+/* Print what the cache did during the last phase; nothing if it was unused */
+static void bcache_print(const struct bcache *c)
+{
+    const struct bcache_stats *s = &c->st;
+    if (s->read_ops + s->write_ops == 0)
+        return;
+
+    printf("    cache:    reads %llu (%.1f%% hits), writes %llu (%.1f%% hits), "
+           "%llu evictions (%llu dirty)\n",
+           (unsigned long long)s->read_ops, s->read_ops ? 100.0 * s->read_hits / s->read_ops : 0,
+           (unsigned long long)s->write_ops, s->write_ops ? 100.0 * s->write_hits / s->write_ops : 0,
+           (unsigned long long)s->evictions, (unsigned long long)s->dirty_evictions);
+    printf("              issued %llu reads (%.2f MB), %llu writes (%.2f MB); "
+           "%.1f%% of written bytes absorbed\n",
+           (unsigned long long)s->issued_reads, s->issued_read_bytes / 1048576.0,
+           (unsigned long long)s->issued_writes, s->issued_write_bytes / 1048576.0,
+           s->app_write_bytes ? 100.0 - 100.0 * s->issued_write_bytes / s->app_write_bytes : 0);
+}
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef DIO_H
+#define DIO_H
+
+/*
+ * Helpers for the O_DIRECT mode of HW112 / HW114.
+ *
+ * The includer must define _GNU_SOURCE before any system header so that
+ * O_DIRECT and statx() are visible.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <fcntl.h>
+
+#include "lat_hist.h"
+
+#define DIO_MIN_CHUNK       512
+#define DIO_MAX_CHUNK       (1024 * 1024)
+
+/* Random phases stop after covering the file this many times at large chunks */
+#define DIO_RANDOM_COVERAGE 4
+
+#define MEASURE_IO(name, bytes, ops, code_block) do {                   \
+    struct timeval __tv1, __tv2;                                        \
+    lat_phase_begin();                                                  \
+    gettimeofday(&__tv1, NULL);                                         \
+    code_block                                                          \
+    gettimeofday(&__tv2, NULL);                                         \
+    unsigned long __diff =                                              \
+        1000000 * (__tv2.tv_sec - __tv1.tv_sec)                         \
+        + (__tv2.tv_usec - __tv1.tv_usec);                              \
+    double __sec = __diff / 1000000.0;                                  \
+    printf("%-25s:   %.4f sec   %9.2f MB/s   %9.0f IOPS\n", name, __sec, \
+           (bytes) / 1048576.0 / __sec, (ops) / __sec);                 \
+    lat_phase_end();                                                    \
+} while (0);
+
+struct dio_align {
+    size_t mem_align;       /* required alignment of the user buffer */
+    size_t ofs_align;       /* required alignment of file offset and length */
+};
+
+static size_t dio_read_sysfs_lbs(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return 0;
+
+    unsigned long lbs = 0;
+    if (fscanf(fp, "%lu", &lbs) != 1)
+        lbs = 0;
+    fclose(fp);
+    return lbs;
+}
+
+/*
+ * Find the direct I/O alignment for `fd`: statx(STATX_DIOALIGN) when the
+ * kernel reports it, otherwise the logical block size of the underlying
+ * device from sysfs (partitions keep it in the parent's queue/ directory).
+ */
+static int dio_get_align(int fd, struct dio_align *align)
+{
+    align->mem_align = 0;
+    align->ofs_align = 0;
+
+#ifdef STATX_DIOALIGN
+    struct statx stx;
+    if (statx(fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &stx) == 0
+        && (stx.stx_mask & STATX_DIOALIGN))
+    {
+        if (stx.stx_dio_offset_align == 0)
+        {
+            fprintf(stderr, "O_DIRECT is not supported on this file\n");
+            return -1;
+        }
+        align->mem_align = stx.stx_dio_mem_align;
+        align->ofs_align = stx.stx_dio_offset_align;
+        return 0;
+    }
+#endif
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        perror("fstat");
+        return -1;
+    }
+
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/queue/logical_block_size",
+             major(st.st_dev), minor(st.st_dev));
+    size_t lbs = dio_read_sysfs_lbs(path);
+    if (!lbs)
+    {
+        snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/../queue/logical_block_size",
+                 major(st.st_dev), minor(st.st_dev));
+        lbs = dio_read_sysfs_lbs(path);
+    }
+    if (!lbs)
+        lbs = 512;
+
+    align->mem_align = lbs;
+    align->ofs_align = lbs;
+    return 0;
+}
+
+/*
+ * Check that I/O of `chunk` bytes, issued at chunk-multiples inside a
+ * `file_size` file and a buffer starting at `buf`, satisfies `align`.
+ */
+static int dio_check(const struct dio_align *align, size_t chunk,
+                     size_t file_size, const void *buf)
+{
+    if (chunk % align->ofs_align != 0)
+    {
+        printf("   chunk %zu is not a multiple of the logical block size %zu\n",
+               chunk, align->ofs_align);
+        return -1;
+    }
+    if (chunk % align->mem_align != 0 || (uintptr_t)buf % align->mem_align != 0)
+    {
+        printf("   chunk %zu breaks the %zu-byte buffer alignment\n",
+               chunk, align->mem_align);
+        return -1;
+    }
+    if (file_size % chunk != 0)
+    {
+        printf("   chunk %zu does not divide the file size %zu\n", chunk, file_size);
+        return -1;
+    }
+    return 0;
+}
+
+static inline int dio_random_ops(size_t chunk, size_t file_size, int default_ops)
+{
+    size_t cap = DIO_RANDOM_COVERAGE * (file_size / chunk);
+    return cap < (size_t)default_ops ? (int)cap : default_ops;
+}
+
+#endif
@@ -0,0 +1,208 @@
+#ifndef FILE_GEN_H
+#define FILE_GEN_H
+
+/*
+ * Parallel test file generator, in place of dd if=/dev/urandom.
+ *
+ * The content is a counter-based splitmix64 stream: the 8 bytes at offset
+ * 8k are a hash of (seed, k). Any byte can be computed without the ones
+ * before it, so threads fill disjoint chunks in any order and the file
+ * comes out the same for a seed regardless of thread count or method.
+ * The bytes are statistically random, so compressing or deduplicating
+ * filesystems and SSD controllers cannot shrink them.
+ *
+ * The range is reserved with posix_fallocate() first, then filled either
+ * with pwrite() from a per-thread buffer or by storing into a shared
+ * mapping of the file.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <sys/mman.h>
+#include <sys/types.h>
+
+#define FILE_GEN_CHUNK          (4 << 20)
+#define FILE_GEN_MAX_THREADS    64
+
+enum file_gen_method { FILE_GEN_PWRITE, FILE_GEN_MMAP };
+
+struct file_gen {
+    int fd;
+    off_t from, to;         /* fill [from, to) */
+    uint64_t seed;
+    enum file_gen_method method;
+    char *map;              /* FILE_GEN_MMAP: the file from map_ofs on */
+    off_t map_ofs;
+    uint64_t next;          /* next chunk to hand out */
+    int failed;
+};
+
+static inline uint64_t file_gen_word(uint64_t seed, uint64_t k)
+{
+    uint64_t z = seed + (k + 1) * 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+/* Store the content of file bytes [ofs, ofs + len) at `dst` */
+static inline void file_gen_bytes(char *dst, off_t ofs, size_t len, uint64_t seed)
+{
+    uint64_t k = ofs / 8;
+    size_t skip = ofs % 8;
+
+    while (len > 0)
+    {
+        uint64_t w = file_gen_word(seed, k++);
+        if (skip == 0 && len >= 8)
+        {
+            memcpy(dst, &w, 8);
+            dst += 8;
+            len -= 8;
+            continue;
+        }
+        size_t n = 8 - skip < len ? 8 - skip : len;
+        memcpy(dst, (char *)&w + skip, n);
+        dst += n;
+        len -= n;
+        skip = 0;
+    }
+}
+
+static void *file_gen_main(void *arg)
+{
+    struct file_gen *g = arg;
+    char *buf = NULL;
+    if (g->method == FILE_GEN_PWRITE && !(buf = malloc(FILE_GEN_CHUNK)))
+    {
+        perror("malloc");
+        __atomic_store_n(&g->failed, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    /* chunks are aligned to FILE_GEN_CHUNK in the file, the first may be short */
+    uint64_t first = g->from / FILE_GEN_CHUNK;
+    while (!__atomic_load_n(&g->failed, __ATOMIC_RELAXED))
+    {
+        off_t start = (first + __atomic_fetch_add(&g->next, 1, __ATOMIC_RELAXED)) * FILE_GEN_CHUNK;
+        if (start >= g->to)
+            break;
+        if (start < g->from)
+            start = g->from;
+        off_t end = (start / FILE_GEN_CHUNK + 1) * FILE_GEN_CHUNK;
+        if (end > g->to)
+            end = g->to;
+        size_t len = end - start;
+
+        if (g->method == FILE_GEN_MMAP)
+        {
+            file_gen_bytes(g->map + (start - g->map_ofs), start, len, g->seed);
+            continue;
+        }
+        file_gen_bytes(buf, start, len, g->seed);
+        if (pwrite(g->fd, buf, len, start) != (ssize_t)len)
+        {
+            perror("pwrite");
+            __atomic_store_n(&g->failed, 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    free(buf);
+    return NULL;
+}
+
+static inline int file_gen_default_threads(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1)
+        return 1;
+    return n < FILE_GEN_MAX_THREADS ? n : FILE_GEN_MAX_THREADS;
+}
+
+/*
+ * Fill bytes [from, to) of the open file `fd` with the content for `seed`,
+ * using `threads` threads, and make them durable. The file grows to `to` if
+ * it is shorter.
+ */
+static int file_gen_fill(int fd, off_t from, off_t to, uint64_t seed,
+                         enum file_gen_method method, int threads)
+{
+    if (from >= to)
+        return 0;
+
+    int err = posix_fallocate(fd, from, to - from);
+    if (err != 0)
+    {
+        fprintf(stderr, "posix_fallocate: %s\n", strerror(err));
+        return -1;
+    }
+
+    struct file_gen g = {
+        .fd = fd,
+        .from = from,
+        .to = to,
+        .seed = seed,
+        .method = method,
+    };
+
+    size_t map_len = 0;
+    if (method == FILE_GEN_MMAP)
+    {
+        g.map_ofs = from / getpagesize() * getpagesize();
+        map_len = to - g.map_ofs;
+        g.map = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, g.map_ofs);
+        if (g.map == MAP_FAILED)
+        {
+            perror("mmap");
+            return -1;
+        }
+    }
+
+    if (threads < 1)
+        threads = 1;
+    if (threads > FILE_GEN_MAX_THREADS)
+        threads = FILE_GEN_MAX_THREADS;
+
+    pthread_t tids[FILE_GEN_MAX_THREADS];
+    int started = 0;
+    for (; started < threads; ++started)
+    {
+        err = pthread_create(&tids[started], NULL, file_gen_main, &g);
+        if (err != 0)
+        {
+            fprintf(stderr, "pthread_create: %s\n", strerror(err));
+            break;
+        }
+    }
+    /* with no thread at all, do the work here */
+    if (started == 0)
+        file_gen_main(&g);
+    for (int i = 0; i < started; ++i)
+        pthread_join(tids[i], NULL);
+
+    int ret = g.failed ? -1 : 0;
+    if (method == FILE_GEN_MMAP)
+    {
+        if (ret == 0 && msync(g.map, map_len, MS_SYNC) != 0)
+        {
+            perror("msync");
+            ret = -1;
+        }
+        munmap(g.map, map_len);
+    }
+    if (ret == 0 && fsync(fd) != 0)
+    {
+        perror("fsync");
+        ret = -1;
+    }
+    return ret;
+}
+
+#endif
@@ -0,0 +1,240 @@
+#ifndef FLUSHER_H
+#define FLUSHER_H
+
+/*
+ * Background flusher: asynchronous durability for the buffered write phases.
+ *
+ * Without it the final fsync of seq_write and random_write_buffered makes
+ * the benchmark thread wait for the whole writeback of the phase. With it,
+ * the writer hands the file range it has dirtied to a flusher thread every
+ * `flusher_threshold` bytes, and the thread writes it back with
+ * sync_file_range() while the writer carries on. The full-file flush at the
+ * end becomes a fence: wait until the flusher has caught up, then issue the
+ * backend's own flush, which by then only has the tail left to do.
+ *
+ * A full queue blocks the writer, much like the kernel throttles a task
+ * that dirties pages faster than they can be written back.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "lat_hist.h"
+
+#define FLUSHER_QUEUE   64
+
+struct flusher_range {
+    off_t ofs;
+    off_t len;
+};
+
+struct flusher_stats {
+    uint64_t ranges;        /* handed to the thread */
+    uint64_t range_bytes;   /* spanned by those ranges */
+    uint64_t sync_ns;       /* thread time in sync_file_range/fdatasync */
+    uint64_t stall_ns;      /* writer blocked on a full queue */
+    uint64_t fence_ns;      /* writer waiting for the thread at a fence */
+    uint64_t flush_ns;      /* backend flush after the fence */
+    uint64_t fences;
+    uint64_t errors;
+};
+
+struct flusher {
+    int fd;
+    pthread_t tid;
+    pthread_mutex_t lock;
+    pthread_cond_t work;    /* queue not empty, or stop */
+    pthread_cond_t done;    /* a range finished */
+    struct flusher_range q[FLUSHER_QUEUE];
+    unsigned head, tail;    /* q[head % FLUSHER_QUEUE] is next */
+    int busy;
+    int stop;
+    int running;
+
+    /* writer side: the range dirtied since the last hand-off */
+    off_t lo, hi;
+    size_t dirty;
+
+    struct flusher_stats st;
+};
+
+static size_t flusher_threshold;        /* > 0: -A given */
+static int flusher_active;              /* the current phase flushes asynchronously */
+static struct flusher flusher;
+
+static void *flusher_main(void *arg)
+{
+    struct flusher *fl = arg;
+
+    pthread_mutex_lock(&fl->lock);
+    while (1)
+    {
+        while (fl->head == fl->tail && !fl->stop)
+            pthread_cond_wait(&fl->work, &fl->lock);
+        if (fl->head == fl->tail)
+            break;
+
+        struct flusher_range r = fl->q[fl->head % FLUSHER_QUEUE];
+        fl->busy = 1;
+        pthread_mutex_unlock(&fl->lock);
+
+        /* start writeback of the range and wait for it */
+        uint64_t t0 = lat_now();
+        int ret = sync_file_range(fl->fd, r.ofs, r.len, SYNC_FILE_RANGE_WAIT_BEFORE
+                                  | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+        if (ret != 0 && (errno == ENOSYS || errno == EINVAL || errno == ESPIPE))
+            ret = fdatasync(fl->fd);
+        uint64_t t1 = lat_now();
+
+        pthread_mutex_lock(&fl->lock);
+        fl->head++;
+        fl->busy = 0;
+        fl->st.sync_ns += t1 - t0;
+        fl->st.errors += ret != 0;
+        pthread_cond_broadcast(&fl->done);
+    }
+    pthread_mutex_unlock(&fl->lock);
+    return NULL;
+}
+
+/* Start the thread for a freshly opened file; it idles until a phase uses it */
+static int flusher_start(int fd)
+{
+    memset(&flusher, 0, sizeof(flusher));
+    flusher.fd = fd;
+    pthread_mutex_init(&flusher.lock, NULL);
+    pthread_cond_init(&flusher.work, NULL);
+    pthread_cond_init(&flusher.done, NULL);
+
+    int err = pthread_create(&flusher.tid, NULL, flusher_main, &flusher);
+    if (err != 0)
+    {
+        fprintf(stderr, "pthread_create: %s\n", strerror(err));
+        return -1;
+    }
+    flusher.running = 1;
+    return 0;
+}
+
+/* Let the thread finish what is queued and join it */
+static void flusher_stop(void)
+{
+    if (!flusher.running)
+        return;
+
+    pthread_mutex_lock(&flusher.lock);
+    flusher.stop = 1;
+    pthread_cond_signal(&flusher.work);
+    pthread_mutex_unlock(&flusher.lock);
+    pthread_join(flusher.tid, NULL);
+
+    pthread_mutex_destroy(&flusher.lock);
+    pthread_cond_destroy(&flusher.work);
+    pthread_cond_destroy(&flusher.done);
+    flusher.running = 0;
+}
+
+/* Queue the range dirtied so far, waiting for room if the queue is full */
+static void flusher_post(void)
+{
+    if (flusher.dirty == 0)
+        return;
+
+    pthread_mutex_lock(&flusher.lock);
+    if (flusher.tail - flusher.head == FLUSHER_QUEUE)
+    {
+        uint64_t t0 = lat_now();
+        while (flusher.tail - flusher.head == FLUSHER_QUEUE)
+            pthread_cond_wait(&flusher.done, &flusher.lock);
+        flusher.st.stall_ns += lat_now() - t0;
+    }
+    flusher.q[flusher.tail++ % FLUSHER_QUEUE] = (struct flusher_range){
+        .ofs = flusher.lo,
+        .len = flusher.hi - flusher.lo,
+    };
+    flusher.st.ranges++;
+    flusher.st.range_bytes += flusher.hi - flusher.lo;
+    pthread_cond_signal(&flusher.work);
+    pthread_mutex_unlock(&flusher.lock);
+
+    flusher.dirty = 0;
+}
+
+/*
+ * Note a completed write. Returns 1 once flusher_threshold bytes are
+ * pending: the caller gets any of them still buffered in user space to the
+ * kernel, then hands the range off with flusher_post().
+ */
+static inline int flusher_dirty(off_t ofs, size_t len)
+{
+    if (!flusher_active)
+        return 0;
+
+    if (flusher.dirty == 0)
+    {
+        flusher.lo = ofs;
+        flusher.hi = ofs + len;
+    }
+    else
+    {
+        if (ofs < flusher.lo)
+            flusher.lo = ofs;
+        if (ofs + (off_t)len > flusher.hi)
+            flusher.hi = ofs + len;
+    }
+    flusher.dirty += len;
+    return flusher.dirty >= flusher_threshold;
+}
+
+/* Hand off the rest and wait until the thread has written back everything */
+static void flusher_fence(void)
+{
+    flusher_post();
+
+    uint64_t t0 = lat_now();
+    pthread_mutex_lock(&flusher.lock);
+    while (flusher.head != flusher.tail || flusher.busy)
+        pthread_cond_wait(&flusher.done, &flusher.lock);
+    pthread_mutex_unlock(&flusher.lock);
+    flusher.st.fence_ns += lat_now() - t0;
+    flusher.st.fences++;
+}
+
+static inline void flusher_phase_begin(void)
+{
+    memset(&flusher.st, 0, sizeof(flusher.st));
+    flusher.dirty = 0;
+}
+
+/*
+ * With -A, report the phase's background work; a phase that ran without the
+ * flusher only shows how long its final flush took, as the baseline.
+ */
+static void flusher_print(void)
+{
+    const struct flusher_stats *s = &flusher.st;
+    if (!flusher_threshold)
+        return;
+    if (!flusher_active)
+    {
+        if (s->flush_ns)
+            printf("    flusher:  off, final flush %.4f sec\n", s->flush_ns / 1e9);
+        return;
+    }
+
+    printf("    flusher:  %llu ranges (%.2f MB) synced in the background in %.4f sec",
+           (unsigned long long)s->ranges, s->range_bytes / 1048576.0, s->sync_ns / 1e9);
+    if (s->errors)
+        printf(", %llu failed", (unsigned long long)s->errors);
+    printf("\n              writer stalled %.4f sec on a full queue, waited %.4f sec at %llu fence%s, "
+           "final flush %.4f sec\n",
+           s->stall_ns / 1e9, s->fence_ns / 1e9, (unsigned long long)s->fences,
+           s->fences == 1 ? "" : "s", s->flush_ns / 1e9);
+}
+
+#endif
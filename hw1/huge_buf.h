@@ -0,0 +1,150 @@
+#ifndef HUGE_BUF_H
+#define HUGE_BUF_H
+
+/*
+ * Huge page backing for the I/O buffer and the file mappings.
+ *
+ * The buffer is as large as the test file and every phase memcpy()s through
+ * it, so with 4K pages a sequential pass touches a new TLB entry every 4K.
+ * Two alternatives:
+ *  - thp: an anonymous mapping aligned to 2MB and madvise(MADV_HUGEPAGE),
+ *    which works whenever transparent huge pages are not disabled outright;
+ *  - hugetlb: MAP_HUGETLB from the preallocated pool (vm.nr_hugepages),
+ *    falling back to thp when the pool is too small.
+ * File mappings can only be advised; whether they get huge pages depends
+ * on the filesystem (tmpfs with huge=, large folios in the page cache).
+ * huge_report() reads /proc/self/smaps to show what was actually granted.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <sys/mman.h>
+
+#define HUGE_PAGE_SIZE          (2UL << 20)
+
+enum huge_mode { HUGE_NONE, HUGE_THP, HUGE_HUGETLB, HUGE_NR_MODES };
+
+static const char *const huge_mode_names[HUGE_NR_MODES] = { "4k", "thp", "hugetlb" };
+
+static inline size_t huge_round(size_t size)
+{
+    return (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+}
+
+static inline char *huge_alloc_thp(size_t size)
+{
+    size_t len = huge_round(size);
+
+    /* over-allocate by one huge page and trim to a 2MB boundary */
+    char *p = mmap(NULL, len + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+    {
+        perror("mmap");
+        return NULL;
+    }
+    char *aligned = (char *)(((uintptr_t)p + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+    if (aligned > p)
+        munmap(p, aligned - p);
+    munmap(aligned + len, p + HUGE_PAGE_SIZE - aligned);
+
+#ifdef MADV_HUGEPAGE
+    if (madvise(aligned, len, MADV_HUGEPAGE) != 0)
+        perror("madvise(MADV_HUGEPAGE)");
+#endif
+    return aligned;
+}
+
+/*
+ * Allocate `size` bytes backed as `*mode` asks, page aligned in any case.
+ * A hugetlb request the pool cannot satisfy falls back to thp, and `*mode`
+ * is updated so huge_free() releases the right way. NULL on failure.
+ */
+static inline char *huge_alloc(size_t size, enum huge_mode *mode)
+{
+    if (*mode == HUGE_HUGETLB)
+    {
+#ifdef MAP_HUGETLB
+        char *p = mmap(NULL, huge_round(size), PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED)
+            return p;
+        printf("hugetlb: %s (is vm.nr_hugepages large enough?), using thp\n", strerror(errno));
+#endif
+        *mode = HUGE_THP;
+    }
+    if (*mode == HUGE_THP)
+        return huge_alloc_thp(size);
+
+    char *p;
+    if (posix_memalign((void **)&p, 4096, size) != 0)
+    {
+        perror("posix_memalign");
+        return NULL;
+    }
+    return p;
+}
+
+static inline void huge_free(char *p, size_t size, enum huge_mode mode)
+{
+    if (mode == HUGE_NONE)
+        free(p);
+    else if (p)
+        munmap(p, huge_round(size));
+}
+
+/* Ask for huge pages on a file mapping; the filesystem may not provide them */
+static inline void huge_advise_map(char *map, size_t size, enum huge_mode mode)
+{
+#ifdef MADV_HUGEPAGE
+    if (mode != HUGE_NONE && madvise(map, size, MADV_HUGEPAGE) != 0)
+        printf("madvise(MADV_HUGEPAGE) on the file mapping: %s\n", strerror(errno));
+#else
+    (void)map, (void)size, (void)mode;
+#endif
+}
+
+/*
+ * Print how much of [p, p + size) is mapped with huge pages, summed over
+ * the smaps entries of the VMAs that overlap it.
+ */
+static inline void huge_report(const char *label, const void *p, size_t size)
+{
+    FILE *fp = fopen("/proc/self/smaps", "r");
+    if (!fp)
+        return;
+
+    uintptr_t lo = (uintptr_t)p, hi = lo + size;
+    unsigned long huge_kb = 0, page_kb = 0;
+    int inside = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), fp))
+    {
+        unsigned long start, end, kb;
+        if (sscanf(line, "%lx-%lx ", &start, &end) == 2 && strchr(line, ':') > strchr(line, ' '))
+        {
+            inside = start < hi && end > lo;
+            continue;
+        }
+        if (!inside)
+            continue;
+        if (sscanf(line, "AnonHugePages: %lu kB", &kb) == 1
+            || sscanf(line, "FilePmdMapped: %lu kB", &kb) == 1
+            || sscanf(line, "ShmemPmdMapped: %lu kB", &kb) == 1
+            || sscanf(line, "Private_Hugetlb: %lu kB", &kb) == 1
+            || sscanf(line, "Shared_Hugetlb: %lu kB", &kb) == 1)
+            huge_kb += kb;
+        else if (sscanf(line, "KernelPageSize: %lu kB", &kb) == 1 && kb > page_kb)
+            page_kb = kb;
+    }
+    fclose(fp);
+
+    printf("    %s: %.1f of %.1f MB on huge pages (kernel page size %lu kB)\n",
+           label, huge_kb / 1024.0, size / 1048576.0, page_kb);
+}
+
+#endif
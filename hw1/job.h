@@ -0,0 +1,382 @@
+#ifndef JOB_H
+#define JOB_H
+
+/*
+ * Mixed workload jobs for the benchmark engine, described in a small
+ * fio-style job file:
+ *
+ *     [global]
+ *     rw=randrw
+ *     rwmixread=70
+ *
+ *     [oltp]
+ *     bssplit=4k/80:16k/20
+ *     rate_iops=2000
+ *     runtime=10s
+ *
+ * A [global] section sets the defaults of the jobs that follow it. Keys:
+ *   rw=read|write|rw|randread|randwrite|randrw   (default randread)
+ *   rwmixread=PCT       share of reads for rw/randrw (default 50)
+ *   bs=SIZE             block size (default 4k)
+ *   bssplit=SIZE/W:...  block sizes drawn with weights W
+ *   rate_iops=N         cap on ops per second
+ *   rate=SIZE           cap on bytes per second
+ *   thinktime=TIME      pause after every thinktime_blocks ops (default unit us)
+ *   thinktime_blocks=N  (default 1)
+ *   fsync=N             flush the file after every N writes
+ *   runtime=TIME        stop after this long (default unit s)
+ *   number_ios=N        stop after N ops
+ * Without runtime or number_ios a job moves as many bytes as the file holds.
+ * Random offsets are aligned to the op's block size.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <time.h>
+
+#include "bench_config.h"
+#include "offset_gen.h"
+
+#define JOB_MAX         16
+#define JOB_MAX_BS      8
+
+struct job_bs {
+    size_t size;
+    unsigned weight;
+};
+
+struct job {
+    char name[64];
+    int random;
+    unsigned read_pct;          /* 100: reads only, 0: writes only */
+    int mix_set;                /* read_pct came from rwmixread/rwmixwrite */
+    struct job_bs bs[JOB_MAX_BS];
+    int nr_bs;
+    unsigned bs_weights;        /* sum of bs[].weight */
+    uint64_t rate_iops;
+    uint64_t rate_bytes;        /* per second */
+    uint64_t think_ns;
+    uint64_t think_blocks;
+    uint64_t fsync_every;
+    uint64_t runtime_ns;
+    uint64_t number_ios;
+};
+
+struct job_list {
+    struct job v[JOB_MAX];
+    int n;
+};
+
+enum job_dir { JOB_READ, JOB_WRITE, JOB_NR_DIRS };
+
+struct job_stats {
+    uint64_t ops[JOB_NR_DIRS];
+    uint64_t bytes[JOB_NR_DIRS];
+    uint64_t flushes;
+    uint64_t late;              /* ops issued behind the rate schedule */
+};
+
+static void job_defaults(struct job *j)
+{
+    memset(j, 0, sizeof(*j));
+    j->random = 1;
+    j->read_pct = 100;
+    j->bs[0].size = 4096;
+    j->bs[0].weight = 1;
+    j->nr_bs = 1;
+    j->bs_weights = 1;
+    j->think_blocks = 1;
+}
+
+/* "250", "250us", "10ms", "2s", "1m"; a bare number is in `unit` ns */
+static int job_parse_time(const char *s, uint64_t unit, uint64_t *out)
+{
+    char *end;
+    double v = strtod(s, &end);
+    if (end == s || v < 0)
+        return -1;
+
+    if (*end == '\0')
+        v *= unit;
+    else if (strcmp(end, "ns") == 0)
+        ;
+    else if (strcmp(end, "us") == 0)
+        v *= 1e3;
+    else if (strcmp(end, "ms") == 0)
+        v *= 1e6;
+    else if (strcmp(end, "s") == 0)
+        v *= 1e9;
+    else if (strcmp(end, "m") == 0)
+        v *= 60e9;
+    else
+        return -1;
+
+    *out = (uint64_t)v;
+    return 0;
+}
+
+static int job_parse_u64(const char *s, uint64_t *out)
+{
+    char *end;
+    errno = 0;
+    unsigned long long v = strtoull(s, &end, 0);
+    if (end == s || *end != '\0' || errno != 0)
+        return -1;
+    *out = v;
+    return 0;
+}
+
+/* "4k/80:16k/20" */
+static int job_parse_bssplit(struct job *j, const char *s)
+{
+    j->nr_bs = 0;
+    j->bs_weights = 0;
+
+    while (*s)
+    {
+        if (j->nr_bs == JOB_MAX_BS)
+            return -1;
+
+        char tok[64];
+        size_t len = strcspn(s, "/:");
+        if (len == 0 || len >= sizeof(tok))
+            return -1;
+        memcpy(tok, s, len);
+        tok[len] = '\0';
+
+        struct job_bs *b = &j->bs[j->nr_bs++];
+        if (bench_parse_size(tok, &b->size) != 0)
+            return -1;
+        s += len;
+
+        b->weight = 1;
+        if (*s == '/')
+        {
+            char *end;
+            b->weight = strtoul(s + 1, &end, 10);
+            if (end == s + 1)
+                return -1;
+            s = end;
+        }
+        j->bs_weights += b->weight;
+        if (*s == ':')
+            s++;
+        else if (*s)
+            return -1;
+    }
+    return j->nr_bs && j->bs_weights ? 0 : -1;
+}
+
+static int job_set(struct job *j, const char *key, const char *val)
+{
+    uint64_t v;
+
+    if (strcmp(key, "rw") == 0 || strcmp(key, "readwrite") == 0)
+    {
+        static const struct { const char *name; int random; int read_pct; } rws[] = {
+            { "read", 0, 100 }, { "write", 0, 0 }, { "rw", 0, -1 }, { "readwrite", 0, -1 },
+            { "randread", 1, 100 }, { "randwrite", 1, 0 }, { "randrw", 1, -1 },
+        };
+        for (size_t i = 0; i < sizeof(rws) / sizeof(rws[0]); ++i)
+        {
+            if (strcmp(val, rws[i].name) != 0)
+                continue;
+            j->random = rws[i].random;
+            /* mixed keeps a rwmixread given earlier, or defaults to 50/50 */
+            if (rws[i].read_pct >= 0)
+                j->read_pct = rws[i].read_pct;
+            else if (!j->mix_set)
+                j->read_pct = 50;
+            return 0;
+        }
+        return -1;
+    }
+    if (strcmp(key, "rwmixread") == 0)
+    {
+        if (job_parse_u64(val, &v) != 0 || v > 100)
+            return -1;
+        j->read_pct = v;
+        j->mix_set = 1;
+        return 0;
+    }
+    if (strcmp(key, "rwmixwrite") == 0)
+    {
+        if (job_parse_u64(val, &v) != 0 || v > 100)
+            return -1;
+        j->read_pct = 100 - v;
+        j->mix_set = 1;
+        return 0;
+    }
+    if (strcmp(key, "bs") == 0 || strcmp(key, "blocksize") == 0)
+    {
+        j->nr_bs = 1;
+        j->bs[0].weight = j->bs_weights = 1;
+        return bench_parse_size(val, &j->bs[0].size);
+    }
+    if (strcmp(key, "bssplit") == 0)
+        return job_parse_bssplit(j, val);
+    if (strcmp(key, "rate_iops") == 0)
+        return job_parse_u64(val, &j->rate_iops);
+    if (strcmp(key, "rate") == 0)
+    {
+        size_t bw;
+        if (bench_parse_size(val, &bw) != 0)
+            return -1;
+        j->rate_bytes = bw;
+        return 0;
+    }
+    if (strcmp(key, "thinktime") == 0)
+        return job_parse_time(val, 1000, &j->think_ns);
+    if (strcmp(key, "thinktime_blocks") == 0)
+        return job_parse_u64(val, &j->think_blocks) != 0 || j->think_blocks == 0 ? -1 : 0;
+    if (strcmp(key, "fsync") == 0)
+        return job_parse_u64(val, &j->fsync_every);
+    if (strcmp(key, "runtime") == 0)
+        return job_parse_time(val, 1000000000, &j->runtime_ns);
+    if (strcmp(key, "number_ios") == 0)
+        return job_parse_u64(val, &j->number_ios);
+    return -1;
+}
+
+static char *job_trim(char *s)
+{
+    while (isspace((unsigned char)*s))
+        s++;
+    char *e = s + strlen(s);
+    while (e > s && isspace((unsigned char)e[-1]))
+        *--e = '\0';
+    return s;
+}
+
+static int job_load(const char *path, struct job_list *jobs)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+    {
+        perror(path);
+        return -1;
+    }
+
+    struct job global, *cur = NULL;
+    job_defaults(&global);
+    jobs->n = 0;
+
+    char line[512];
+    int lineno = 0;
+    while (fgets(line, sizeof(line), fp))
+    {
+        lineno++;
+        char *s = job_trim(line);
+        if (*s == '\0' || *s == '#' || *s == ';')
+            continue;
+
+        if (*s == '[')
+        {
+            char *end = strchr(s, ']');
+            if (!end)
+                goto bad;
+            *end = '\0';
+            s = job_trim(s + 1);
+
+            if (strcmp(s, "global") == 0)
+                cur = &global;
+            else
+            {
+                if (jobs->n == JOB_MAX)
+                {
+                    fprintf(stderr, "%s:%d: at most %d jobs\n", path, lineno, JOB_MAX);
+                    fclose(fp);
+                    return -1;
+                }
+                cur = &jobs->v[jobs->n++];
+                *cur = global;
+                snprintf(cur->name, sizeof(cur->name), "%s", s);
+            }
+            continue;
+        }
+
+        char *eq = strchr(s, '=');
+        if (!cur || !eq)
+            goto bad;
+        *eq = '\0';
+        if (job_set(cur, job_trim(s), job_trim(eq + 1)) != 0)
+            goto bad;
+    }
+    fclose(fp);
+
+    if (jobs->n == 0)
+    {
+        fprintf(stderr, "%s: no jobs\n", path);
+        return -1;
+    }
+    return 0;
+
+bad:
+    fprintf(stderr, "%s:%d: cannot parse '%s'\n", path, lineno, job_trim(line));
+    fclose(fp);
+    return -1;
+}
+
+static inline size_t job_max_bs(const struct job *j)
+{
+    size_t max = 0;
+    for (int i = 0; i < j->nr_bs; ++i)
+        if (j->bs[i].size > max)
+            max = j->bs[i].size;
+    return max;
+}
+
+static inline size_t job_pick_bs(const struct job *j, struct pcg32 *g)
+{
+    if (j->nr_bs == 1)
+        return j->bs[0].size;
+
+    uint64_t w = pcg32_bounded(g, j->bs_weights);
+    int i = 0;
+    while (w >= j->bs[i].weight)
+        w -= j->bs[i++].weight;
+    return j->bs[i].size;
+}
+
+/* Nanoseconds the rate caps allot to one op of `len` bytes */
+static inline uint64_t job_interval(const struct job *j, size_t len)
+{
+    uint64_t ns = 0;
+    if (j->rate_iops)
+        ns = 1000000000ull / j->rate_iops;
+    if (j->rate_bytes && len * 1000000000ull / j->rate_bytes > ns)
+        ns = len * 1000000000ull / j->rate_bytes;
+    return ns;
+}
+
+static inline void job_sleep_until(uint64_t ns)
+{
+    struct timespec ts = {
+        .tv_sec = ns / 1000000000ull,
+        .tv_nsec = ns % 1000000000ull,
+    };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+}
+
+static void job_print_stats(const struct job_stats *st, double sec)
+{
+    uint64_t ops = st->ops[JOB_READ] + st->ops[JOB_WRITE];
+    uint64_t bytes = st->bytes[JOB_READ] + st->bytes[JOB_WRITE];
+
+    printf("    job:      read %llu ops (%.2f MB), write %llu ops (%.2f MB), %llu flushes",
+           (unsigned long long)st->ops[JOB_READ], st->bytes[JOB_READ] / 1048576.0,
+           (unsigned long long)st->ops[JOB_WRITE], st->bytes[JOB_WRITE] / 1048576.0,
+           (unsigned long long)st->flushes);
+    if (sec > 0)
+        printf(", %.0f IOPS, %.2f MB/s", ops / sec, bytes / 1048576.0 / sec);
+    if (st->late)
+        printf(", %llu ops behind the rate", (unsigned long long)st->late);
+    printf("\n");
+}
+
+#endif
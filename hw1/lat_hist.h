@@ -0,0 +1,188 @@
+#ifndef LAT_HIST_H
+#define LAT_HIST_H
+
+/*
+ * Per-operation latency recorder for the hw1 benchmarks.
+ *
+ * Samples are nanoseconds from CLOCK_MONOTONIC, stored HDR-style: values
+ * below LAT_SUB are exact, above that every power of two is split into
+ * LAT_SUB linear sub-buckets, which bounds the relative error to
+ * 1 / LAT_SUB (~3%) from nanoseconds up to hours with a fixed 15KB table.
+ *
+ * Recording is off unless lat_enabled is set, in which case LAT() costs
+ * two clock reads and a few arithmetic ops per call.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#define LAT_SUB_BITS    5
+#define LAT_SUB         (1 << LAT_SUB_BITS)
+#define LAT_BUCKETS     ((64 - LAT_SUB_BITS + 1) * LAT_SUB)
+
+enum lat_op { LAT_READ, LAT_WRITE, LAT_FLUSH, LAT_SYNC, LAT_NR_OPS };
+
+static const char *const lat_op_names[LAT_NR_OPS] = { "read", "write", "flush", "sync" };
+
+struct lat_hist {
+    uint64_t counts[LAT_BUCKETS];
+    uint64_t count;
+    uint64_t min;
+    uint64_t max;
+    uint64_t sum;
+};
+
+static int lat_enabled;
+static uint64_t lat_overhead;                   /* calibrated cost of one lat_now() pair */
+static struct lat_hist lat_hists[LAT_NR_OPS];   /* current phase, single-threaded paths */
+
+static inline uint64_t lat_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static inline int lat_bucket(uint64_t v)
+{
+    if (v < LAT_SUB)
+        return (int)v;
+
+    int e = 63 - __builtin_clzll(v);
+    int sub = (int)(v >> (e - LAT_SUB_BITS)) & (LAT_SUB - 1);
+    return (e - LAT_SUB_BITS + 1) * LAT_SUB + sub;
+}
+
+/* Midpoint of the values that land in bucket `idx` */
+static inline uint64_t lat_bucket_value(int idx)
+{
+    if (idx < LAT_SUB)
+        return idx;
+
+    int e = idx / LAT_SUB + LAT_SUB_BITS - 1;
+    uint64_t sub = idx % LAT_SUB;
+    uint64_t width = 1ull << (e - LAT_SUB_BITS);
+    return (LAT_SUB + sub) * width + width / 2;
+}
+
+static inline void lat_record(struct lat_hist *h, uint64_t ns)
+{
+    ns = ns > lat_overhead ? ns - lat_overhead : 0;
+
+    h->counts[lat_bucket(ns)]++;
+    if (h->count == 0 || ns < h->min)
+        h->min = ns;
+    if (ns > h->max)
+        h->max = ns;
+    h->count++;
+    h->sum += ns;
+}
+
+static inline void lat_merge(struct lat_hist *dst, const struct lat_hist *src)
+{
+    if (src->count == 0)
+        return;
+
+    for (int i = 0; i < LAT_BUCKETS; ++i)
+        dst->counts[i] += src->counts[i];
+    if (dst->count == 0 || src->min < dst->min)
+        dst->min = src->min;
+    if (src->max > dst->max)
+        dst->max = src->max;
+    dst->count += src->count;
+    dst->sum += src->sum;
+}
+
+static inline uint64_t lat_percentile(const struct lat_hist *h, double p)
+{
+    uint64_t target = (uint64_t)(p / 100.0 * h->count + 0.5);
+    if (target == 0)
+        target = 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < LAT_BUCKETS; ++i)
+    {
+        seen += h->counts[i];
+        if (seen >= target)
+        {
+            uint64_t v = lat_bucket_value(i);
+            return v > h->max ? h->max : v;
+        }
+    }
+    return h->max;
+}
+
+/*
+ * Time `call` into histogram `h` when recording is enabled and evaluate to
+ * its result, e.g. `if (LAT_H(h, read(fd, p, n)) != n)`.
+ */
+#define LAT_H(h, call) ({                                   \
+    __typeof__(call) __lat_ret;                             \
+    if (lat_enabled)                                        \
+    {                                                       \
+        uint64_t __lat_t0 = lat_now();                      \
+        __lat_ret = (call);                                 \
+        lat_record((h), lat_now() - __lat_t0);              \
+    }                                                       \
+    else                                                    \
+        __lat_ret = (call);                                 \
+    __lat_ret;                                              \
+})
+
+#define LAT(op, call)   LAT_H(&lat_hists[op], call)
+
+/*
+ * Measure the cost of a back-to-back lat_now() pair. The median is
+ * subtracted from every later sample so that sub-microsecond ops (memcpy
+ * from a mapping, buffered fwrite) are not dominated by the timer itself.
+ */
+static inline void lat_calibrate(void)
+{
+    enum { ROUNDS = 100001 };
+    static struct lat_hist h;
+
+    lat_overhead = 0;
+    memset(&h, 0, sizeof(h));
+    for (int i = 0; i < ROUNDS; ++i)
+    {
+        uint64_t t0 = lat_now();
+        lat_record(&h, lat_now() - t0);
+    }
+    lat_overhead = lat_percentile(&h, 50.0);
+
+    printf("Timer overhead (CLOCK_MONOTONIC): median %llu ns, min %llu ns, p99 %llu ns\n",
+           (unsigned long long)lat_overhead, (unsigned long long)h.min,
+           (unsigned long long)lat_percentile(&h, 99.0));
+}
+
+static inline void lat_phase_begin(void)
+{
+    if (lat_enabled)
+        memset(lat_hists, 0, sizeof(lat_hists));
+}
+
+static inline void lat_phase_end(void)
+{
+    if (!lat_enabled)
+        return;
+
+    for (int op = 0; op < LAT_NR_OPS; ++op)
+    {
+        const struct lat_hist *h = &lat_hists[op];
+        if (h->count == 0)
+            continue;
+
+        printf("    %-6s n=%-8llu avg=%9.2f p50=%9.2f p90=%9.2f p99=%9.2f p99.9=%9.2f max=%9.2f us\n",
+               lat_op_names[op], (unsigned long long)h->count,
+               h->sum / (double)h->count / 1000.0,
+               lat_percentile(h, 50.0) / 1000.0,
+               lat_percentile(h, 90.0) / 1000.0,
+               lat_percentile(h, 99.0) / 1000.0,
+               lat_percentile(h, 99.9) / 1000.0,
+               h->max / 1000.0);
+    }
+}
+
+#endif
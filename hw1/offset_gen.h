@@ -0,0 +1,222 @@
+#ifndef OFFSET_GEN_H
+#define OFFSET_GEN_H
+
+/*
+ * Deterministic offset generator for the random phases.
+ *
+ * A PCG32 generator (O'Neill, pcg-random.org) drives one of several
+ * access distributions over `nslots` equally sized slots of the file.
+ * Offsets are generated into an array before a phase starts, so the timed
+ * loop only does an array load instead of calling rand().
+ *
+ * Needs -lm for the Zipfian sampler.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include <sys/types.h>
+
+enum offset_dist_kind {
+    DIST_UNIFORM,
+    DIST_ZIPF,              /* rank k drawn with probability ~ 1 / k^theta */
+    DIST_HOTSPOT,           /* hot_ops % of ops land in the first hot_space % of the file */
+    DIST_STRIDE,            /* op i at slot i * stride, wrapping at the end of the file */
+};
+
+static const char *const offset_dist_names[] = { "uniform", "zipf", "hotspot", "stride" };
+
+struct offset_dist {
+    enum offset_dist_kind kind;
+    double theta;
+    double hot_ops;
+    double hot_space;
+    size_t stride;          /* bytes */
+};
+
+struct pcg32 {
+    uint64_t state;
+    uint64_t inc;
+};
+
+static inline uint32_t pcg32_next(struct pcg32 *g)
+{
+    uint64_t old = g->state;
+    g->state = old * 6364136223846793005ull + g->inc;
+    uint32_t xorshifted = ((old >> 18) ^ old) >> 27;
+    uint32_t rot = old >> 59;
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+/* Independent sequences for the same seed come from different `stream`s */
+static inline void pcg32_seed(struct pcg32 *g, uint64_t seed, uint64_t stream)
+{
+    g->state = 0;
+    g->inc = (stream << 1) | 1;
+    pcg32_next(g);
+    g->state += seed;
+    pcg32_next(g);
+}
+
+static inline uint64_t pcg32_next64(struct pcg32 *g)
+{
+    uint64_t hi = pcg32_next(g);
+    return (hi << 32) | pcg32_next(g);
+}
+
+/* Uniform in [0, n) without modulo bias (Lemire's multiply-and-reject) */
+static inline uint64_t pcg32_bounded(struct pcg32 *g, uint64_t n)
+{
+    __uint128_t m = (__uint128_t)pcg32_next64(g) * n;
+    uint64_t low = (uint64_t)m;
+    if (low < n)
+    {
+        uint64_t threshold = -n % n;
+        while (low < threshold)
+        {
+            m = (__uint128_t)pcg32_next64(g) * n;
+            low = (uint64_t)m;
+        }
+    }
+    return m >> 64;
+}
+
+/* Uniform in [0, 1) */
+static inline double pcg32_double(struct pcg32 *g)
+{
+    return (pcg32_next64(g) >> 11) * 0x1.0p-53;
+}
+
+/*
+ * Zipf sampling by rejection-inversion (Hormann & Derflinger, 1996): O(1)
+ * per sample and no table, so it works for billions of slots.
+ */
+struct zipf {
+    double theta;
+    double n;
+    double h_x1;
+    double h_n;
+    double s;
+};
+
+static inline double zipf_helper1(double x)
+{
+    return fabs(x) > 1e-8 ? log1p(x) / x : 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
+}
+
+static inline double zipf_helper2(double x)
+{
+    return fabs(x) > 1e-8 ? expm1(x) / x : 1 + x * 0.5 * (1 + x / 3 * (1 + 0.25 * x));
+}
+
+static inline double zipf_h(const struct zipf *z, double x)
+{
+    return exp(-z->theta * log(x));
+}
+
+static inline double zipf_h_integral(const struct zipf *z, double x)
+{
+    double log_x = log(x);
+    return zipf_helper2((1 - z->theta) * log_x) * log_x;
+}
+
+static inline double zipf_h_integral_inv(const struct zipf *z, double x)
+{
+    double t = x * (1 - z->theta);
+    if (t < -1)
+        t = -1;
+    return exp(zipf_helper1(t) * x);
+}
+
+static inline void zipf_init(struct zipf *z, double theta, uint64_t n)
+{
+    z->theta = theta;
+    z->n = (double)n;
+    z->h_x1 = zipf_h_integral(z, 1.5) - 1;
+    z->h_n = zipf_h_integral(z, z->n + 0.5);
+    z->s = 2 - zipf_h_integral_inv(z, zipf_h_integral(z, 2.5) - zipf_h(z, 2));
+}
+
+/* Rank in [0, n), rank 0 being the most popular */
+static inline uint64_t zipf_next(const struct zipf *z, struct pcg32 *g)
+{
+    while (1)
+    {
+        double u = z->h_n + pcg32_double(g) * (z->h_x1 - z->h_n);
+        double x = zipf_h_integral_inv(z, u);
+        double k = floor(x + 0.5);
+        if (k < 1)
+            k = 1;
+        else if (k > z->n)
+            k = z->n;
+        if (k - x <= z->s || u >= zipf_h_integral(z, k + 0.5) - zipf_h(z, k))
+            return (uint64_t)k - 1;
+    }
+}
+
+/*
+ * Fill `out` with `n` offsets of `slot`-byte granularity in a file of
+ * `nslots` slots. Zipf ranks are scattered over the file by a multiplicative
+ * permutation, so the hot slots are not all adjacent.
+ */
+static inline void offset_gen_fill(off_t *out, int n, const struct offset_dist *d,
+                                   uint64_t seed, uint64_t stream,
+                                   uint64_t nslots, size_t slot)
+{
+    struct pcg32 g;
+    pcg32_seed(&g, seed, stream);
+
+    switch (d->kind)
+    {
+    case DIST_UNIFORM:
+        for (int i = 0; i < n; ++i)
+            out[i] = (off_t)pcg32_bounded(&g, nslots) * slot;
+        break;
+
+    case DIST_ZIPF:
+    {
+        struct zipf z;
+        zipf_init(&z, d->theta, nslots);
+
+        uint64_t mult = 2654435761u;        /* prime, so coprime to nslots in practice */
+        while (nslots % mult == 0)
+            mult += 2;
+        for (int i = 0; i < n; ++i)
+        {
+            __uint128_t rank = zipf_next(&z, &g);
+            out[i] = (off_t)((rank * mult) % nslots) * slot;
+        }
+        break;
+    }
+
+    case DIST_HOTSPOT:
+    {
+        uint64_t hot = (uint64_t)(nslots * d->hot_space / 100.0);
+        if (hot == 0)
+            hot = 1;
+        if (hot > nslots)
+            hot = nslots;
+        for (int i = 0; i < n; ++i)
+        {
+            if (hot == nslots || pcg32_double(&g) * 100.0 < d->hot_ops)
+                out[i] = (off_t)pcg32_bounded(&g, hot) * slot;
+            else
+                out[i] = (off_t)(hot + pcg32_bounded(&g, nslots - hot)) * slot;
+        }
+        break;
+    }
+
+    case DIST_STRIDE:
+    {
+        uint64_t step = (d->stride + slot - 1) / slot;
+        if (step == 0)
+            step = 1;
+        for (int i = 0; i < n; ++i)
+            out[i] = (off_t)(((__uint128_t)i * step) % nslots) * slot;
+        break;
+    }
+    }
+}
+
+#endif
@@ -0,0 +1,254 @@
+#ifndef PAGE_CACHE_H
+#define PAGE_CACHE_H
+
+/*
+ * Page cache residency and eviction for a single file, without root.
+ *
+ * Eviction writes the file's dirty pages back (fdatasync) and then asks
+ * the kernel to drop its clean pages (POSIX_FADV_DONTNEED). Unlike
+ * writing to /proc/sys/vm/drop_caches this touches no other file on the
+ * machine, so cold-cache runs are possible on shared hosts. Pages that are
+ * still mapped by a process or under writeback are skipped by the kernel,
+ * hence the residency check with mincore() afterwards.
+ *
+ * The same residency count, together with the system-wide Dirty and
+ * Writeback figures from /proc/meminfo, is sampled before and after every
+ * phase (cache_phase_begin/end) and, in timeline mode, by a background
+ * thread during the phase, to line throughput cliffs up with writeback.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <sys/mman.h>
+
+#include "lat_hist.h"
+
+#define PAGE_CACHE_EVICT_TRIES  3
+#define PAGE_CACHE_WINDOW_PAGES 65536       /* residency scan: 256MB of 4K pages per mmap */
+
+/* One look at the file and at the system's dirty memory */
+struct cache_sample {
+    uint64_t t_ns;          /* since the start of the phase */
+    long resident;          /* pages of the file in the page cache */
+    long dirty_kb;          /* /proc/meminfo Dirty */
+    long writeback_kb;      /* /proc/meminfo Writeback */
+};
+
+struct cache_timeline {
+    int fd;
+    size_t size;
+    uint64_t start;
+    struct cache_sample *samples;
+    size_t n;
+    size_t cap;
+    int stop;
+    pthread_t tid;
+};
+
+static int cache_report;                /* sample before and after every phase */
+static int cache_timeline_ms;           /* > 0: also sample during the phase */
+
+static struct cache_sample cache_before;
+static struct cache_timeline cache_tl;
+static int cache_tl_running;
+
+/*
+ * Pages of the first `size` bytes of `fd` that are in the page cache, or -1.
+ * The file is mapped one window at a time, so neither the mapping nor the
+ * mincore() vector grows with the file.
+ */
+static long page_cache_resident(int fd, size_t size)
+{
+    size_t page_size = getpagesize();
+    size_t window = (size_t)PAGE_CACHE_WINDOW_PAGES * page_size;
+
+    unsigned char *vec = malloc(PAGE_CACHE_WINDOW_PAGES);
+    if (!vec)
+    {
+        perror("malloc");
+        return -1;
+    }
+
+    long resident = 0;
+    for (size_t ofs = 0; ofs < size && resident >= 0; ofs += window)
+    {
+        size_t len = size - ofs < window ? size - ofs : window;
+        void *map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, ofs);
+        if (map == MAP_FAILED)
+        {
+            perror("mmap");
+            resident = -1;
+            break;
+        }
+
+        if (mincore(map, len, vec) == 0)
+        {
+            for (size_t i = 0; i < (len + page_size - 1) / page_size; ++i)
+                resident += vec[i] & 1;
+        }
+        else
+        {
+            perror("mincore");
+            resident = -1;
+        }
+        munmap(map, len);
+    }
+
+    free(vec);
+    return resident;
+}
+
+/*
+ * Write back and drop the cached pages of `fd`. Pages that were under
+ * writeback during the first pass are retried. Returns the number of pages
+ * still resident afterwards, or -1 on error.
+ */
+static long page_cache_evict(int fd, size_t size)
+{
+    long resident = -1;
+    for (int i = 0; i < PAGE_CACHE_EVICT_TRIES; ++i)
+    {
+        if (fdatasync(fd) != 0)
+        {
+            perror("fdatasync");
+            return -1;
+        }
+
+        int err = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        if (err != 0)
+        {
+            errno = err;
+            perror("posix_fadvise");
+            return -1;
+        }
+
+        resident = page_cache_resident(fd, size);
+        if (resident <= 0)
+            break;
+    }
+    return resident;
+}
+
+/* System-wide Dirty and Writeback in kB; -1 where /proc/meminfo lacks them */
+static void page_cache_meminfo(long *dirty_kb, long *writeback_kb)
+{
+    *dirty_kb = *writeback_kb = -1;
+
+    FILE *fp = fopen("/proc/meminfo", "r");
+    if (!fp)
+        return;
+
+    char line[256];
+    while (fgets(line, sizeof(line), fp))
+    {
+        if (strncmp(line, "Dirty:", 6) == 0)
+            *dirty_kb = atol(line + 6);
+        else if (strncmp(line, "Writeback:", 10) == 0)
+            *writeback_kb = atol(line + 10);
+    }
+    fclose(fp);
+}
+
+static void page_cache_sample(int fd, size_t size, uint64_t start, struct cache_sample *s)
+{
+    s->t_ns = lat_now() - start;
+    s->resident = page_cache_resident(fd, size);
+    page_cache_meminfo(&s->dirty_kb, &s->writeback_kb);
+}
+
+static void cache_sample_print(const char *label, const struct cache_sample *s, size_t size)
+{
+    long pages = (size + getpagesize() - 1) / getpagesize();
+    printf("    %-10s resident %5.1f%%   dirty %8ld kB   writeback %8ld kB\n",
+           label, pages ? 100.0 * s->resident / pages : 0.0, s->dirty_kb, s->writeback_kb);
+}
+
+/* Timeline thread: one sample every cache_timeline_ms on an absolute schedule */
+static void *cache_timeline_main(void *arg)
+{
+    struct cache_timeline *tl = arg;
+    uint64_t due = tl->start;
+
+    while (!__atomic_load_n(&tl->stop, __ATOMIC_ACQUIRE))
+    {
+        if (tl->n == tl->cap)
+        {
+            size_t cap = tl->cap ? 2 * tl->cap : 256;
+            struct cache_sample *samples = realloc(tl->samples, cap * sizeof(*samples));
+            if (!samples)
+                break;
+            tl->samples = samples;
+            tl->cap = cap;
+        }
+        page_cache_sample(tl->fd, tl->size, tl->start, &tl->samples[tl->n++]);
+
+        due += (uint64_t)cache_timeline_ms * 1000000;
+        struct timespec ts = {
+            .tv_sec = due / 1000000000ull,
+            .tv_nsec = due % 1000000000ull,
+        };
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+            ;
+    }
+    return NULL;
+}
+
+/* Take the "before" sample and start the timeline thread, if enabled */
+static void cache_phase_begin(int fd, size_t size)
+{
+    if (!cache_report)
+        return;
+
+    uint64_t start = lat_now();
+    page_cache_sample(fd, size, start, &cache_before);
+
+    if (cache_timeline_ms <= 0)
+        return;
+
+    cache_tl.fd = fd;
+    cache_tl.size = size;
+    cache_tl.start = start;
+    cache_tl.n = 0;
+    cache_tl.stop = 0;
+    int err = pthread_create(&cache_tl.tid, NULL, cache_timeline_main, &cache_tl);
+    if (err != 0)
+        fprintf(stderr, "pthread_create: %s\n", strerror(err));
+    cache_tl_running = err == 0;
+}
+
+/* Stop the timeline, take the "after" sample and print everything */
+static void cache_phase_end(int fd, size_t size)
+{
+    if (!cache_report)
+        return;
+
+    if (cache_tl_running)
+    {
+        __atomic_store_n(&cache_tl.stop, 1, __ATOMIC_RELEASE);
+        pthread_join(cache_tl.tid, NULL);
+        cache_tl_running = 0;
+    }
+
+    struct cache_sample after;
+    page_cache_sample(fd, size, 0, &after);
+
+    cache_sample_print("before:", &cache_before, size);
+    for (size_t i = 0; i < cache_tl.n; ++i)
+    {
+        char label[32];
+        snprintf(label, sizeof(label), "%.0f ms:", cache_tl.samples[i].t_ns / 1e6);
+        cache_sample_print(label, &cache_tl.samples[i], size);
+    }
+    cache_sample_print("after:", &after, size);
+    cache_tl.n = 0;
+}
+
+#endif
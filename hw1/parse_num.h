@@ -0,0 +1,81 @@
+#ifndef PARSE_NUM_H
+#define PARSE_NUM_H
+
+/*
+ * Command line numbers for the hw1 programs: sizes with an optional
+ * K/M/G/T suffix, bounded counts and 64-bit seeds. Each rejects trailing
+ * garbage, signs and values that do not fit, with a message on stderr.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+
+/*
+ * Parse a non-zero size at the start of `s`. The size must be followed by
+ * the end of the string or by one of the characters in `seps`, so list
+ * parsers can pass ",:" and stop at the next element.
+ */
+static inline int parse_size_sep(const char *s, size_t *out, const char *seps)
+{
+    char *end;
+    errno = 0;
+    unsigned long long v = strtoull(s, &end, 0);
+    int shift = 0;
+    switch (*end)
+    {
+    case 'k': case 'K': shift = 10; end++; break;
+    case 'm': case 'M': shift = 20; end++; break;
+    case 'g': case 'G': shift = 30; end++; break;
+    case 't': case 'T': shift = 40; end++; break;
+    }
+    if (end == s || s[strspn(s, " \t")] == '-' || errno == ERANGE
+        || (*end != '\0' && !strchr(seps, *end)) || v == 0
+        || v > (ULLONG_MAX >> shift) || (v << shift) > SIZE_MAX)
+    {
+        fprintf(stderr, "Invalid size '%s'\n", s);
+        return -1;
+    }
+    *out = v << shift;
+    return 0;
+}
+
+static inline int parse_size(const char *s, size_t *out)
+{
+    return parse_size_sep(s, out, "");
+}
+
+/* Parse a decimal count in [min, max]; `what` names it in the message */
+static inline int parse_count(const char *s, long min, long max, const char *what, long *out)
+{
+    char *end;
+    errno = 0;
+    long v = strtol(s, &end, 10);
+    if (end == s || *end != '\0' || errno == ERANGE || v < min || v > max)
+    {
+        fprintf(stderr, "Invalid %s '%s' (%ld..%ld)\n", what, s, min, max);
+        return -1;
+    }
+    *out = v;
+    return 0;
+}
+
+/* Parse a 64-bit seed, decimal or 0x hex */
+static inline int parse_seed(const char *s, uint64_t *out)
+{
+    char *end;
+    errno = 0;
+    unsigned long long v = strtoull(s, &end, 0);
+    if (end == s || *end != '\0' || errno == ERANGE || s[strspn(s, " \t")] == '-')
+    {
+        fprintf(stderr, "Invalid seed '%s'\n", s);
+        return -1;
+    }
+    *out = v;
+    return 0;
+}
+
+#endif
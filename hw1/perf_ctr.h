@@ -0,0 +1,219 @@
+#ifndef PERF_CTR_H
+#define PERF_CTR_H
+
+/*
+ * Per-phase CPU counters from perf_event_open(2), for the benchmark thread.
+ *
+ * The hardware events (cycles, instructions, LLC and dTLB misses) are
+ * opened as one group so IPC and the miss rates come from the same
+ * scheduling window; software events (page faults, context switches,
+ * task clock) are always counted on their own. When the hardware events
+ * cannot be opened -- no PMU in a VM, or perf_event_paranoid too strict --
+ * the kernel side is excluded first and, failing that, only the software
+ * events are reported. Counts are scaled if the kernel had to multiplex.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define PERF_CACHE(cache, op, result) \
+    ((cache) | ((op) << 8) | ((result) << 16))
+
+struct perf_event_def {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+    int per_kb;             /* print the count per KB transferred */
+};
+
+enum {
+    PERF_CYCLES, PERF_INSTRUCTIONS, PERF_LLC_MISSES, PERF_DTLB_MISSES,
+    PERF_NR_HW,
+    PERF_PAGE_FAULTS = PERF_NR_HW, PERF_MAJOR_FAULTS, PERF_CTX_SWITCHES, PERF_TASK_CLOCK,
+    PERF_NR_EVENTS
+};
+
+static const struct perf_event_def perf_events[PERF_NR_EVENTS] = {
+    { "cycles",       PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES,   0 },
+    { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, 0 },
+    { "LLC misses",   PERF_TYPE_HW_CACHE,
+      PERF_CACHE(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS), 1 },
+    { "dTLB misses",  PERF_TYPE_HW_CACHE,
+      PERF_CACHE(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS), 1 },
+    { "page faults",  PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS,     1 },
+    { "major faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MAJ, 0 },
+    { "ctx switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, 0 },
+    { "task clock",   PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK,      0 },
+};
+
+static int perf_enabled;
+static int perf_fds[PERF_NR_EVENTS];
+static int perf_leader = -1;            /* first hardware event that opened */
+static uint64_t perf_counts[PERF_NR_EVENTS];
+static int perf_valid[PERF_NR_EVENTS];
+
+static int perf_open_event(const struct perf_event_def *e, int group_fd, int exclude_kernel)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = e->type;
+    attr.config = e->config;
+    attr.disabled = group_fd == -1;
+    attr.exclude_kernel = exclude_kernel;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    /* this thread, any CPU */
+    return syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+/*
+ * Open the counters once, before the first phase. Returns 0 if at least the
+ * software events are available; otherwise clears perf_enabled.
+ */
+static int perf_init(void)
+{
+    for (int i = 0; i < PERF_NR_EVENTS; ++i)
+        perf_fds[i] = -1;
+
+    int exclude_kernel = 0;
+    perf_fds[0] = perf_open_event(&perf_events[0], -1, 0);
+    if (perf_fds[0] == -1 && (errno == EACCES || errno == EPERM))
+    {
+        exclude_kernel = 1;
+        perf_fds[0] = perf_open_event(&perf_events[0], -1, 1);
+    }
+
+    if (perf_fds[0] == -1)
+        printf("perf: hardware counters unavailable (%s), reporting software events only\n",
+               strerror(errno));
+    else
+    {
+        perf_leader = perf_fds[0];
+        for (int i = 1; i < PERF_NR_HW; ++i)
+            perf_fds[i] = perf_open_event(&perf_events[i], perf_leader, exclude_kernel);
+        if (exclude_kernel)
+            printf("perf: kernel excluded from hardware counts (perf_event_paranoid)\n");
+    }
+
+    /*
+     * Software events count kernel mode too when allowed, whatever the
+     * hardware counters got: faults taken in copy_to/from_user are kernel
+     * mode faults, and most of a syscall backend's.
+     */
+    int any = 0, sw_user_only = 0;
+    for (int i = PERF_NR_HW; i < PERF_NR_EVENTS; ++i)
+    {
+        perf_fds[i] = perf_open_event(&perf_events[i], -1, 0);
+        if (perf_fds[i] == -1 && (errno == EACCES || errno == EPERM))
+        {
+            perf_fds[i] = perf_open_event(&perf_events[i], -1, 1);
+            sw_user_only |= perf_fds[i] != -1;
+        }
+        any |= perf_fds[i] != -1;
+    }
+    if (sw_user_only)
+        printf("perf: kernel excluded from software counts, faults in syscalls are missed (perf_event_paranoid)\n");
+    if (!any && perf_leader == -1)
+    {
+        perror("perf_event_open");
+        perf_enabled = 0;
+        return -1;
+    }
+    return 0;
+}
+
+static inline void perf_phase_begin(void)
+{
+    if (!perf_enabled)
+        return;
+
+    /* the leader resets and enables its whole group */
+    if (perf_leader != -1)
+    {
+        ioctl(perf_leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(perf_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+    for (int i = PERF_NR_HW; i < PERF_NR_EVENTS; ++i)
+    {
+        if (perf_fds[i] == -1)
+            continue;
+        ioctl(perf_fds[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(perf_fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+/* Stop and read the counters; printing is left to perf_phase_print() */
+static inline void perf_phase_end(void)
+{
+    if (!perf_enabled)
+        return;
+
+    if (perf_leader != -1)
+        ioctl(perf_leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    for (int i = PERF_NR_HW; i < PERF_NR_EVENTS; ++i)
+        if (perf_fds[i] != -1)
+            ioctl(perf_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+
+    for (int i = 0; i < PERF_NR_EVENTS; ++i)
+    {
+        uint64_t v[3];      /* value, time enabled, time running */
+        perf_valid[i] = perf_fds[i] != -1 && read(perf_fds[i], v, sizeof(v)) == sizeof(v)
+                        && v[2] > 0;
+        if (perf_valid[i])
+            perf_counts[i] = v[2] < v[1] ? (uint64_t)((double)v[0] * v[1] / v[2]) : v[0];
+    }
+}
+
+static inline void perf_print_count(const char *name, uint64_t n, double kb, int per_kb)
+{
+    if (n >= 10000000)
+        printf("%s %.1fM", name, n / 1e6);
+    else if (n >= 10000)
+        printf("%s %.1fk", name, n / 1e3);
+    else
+        printf("%s %llu", name, (unsigned long long)n);
+    if (per_kb && kb > 0)
+        printf(" (%.3f/KB)", n / kb);
+}
+
+/* Print the last phase's counts; `bytes` it transferred gives the per-KB rates */
+static inline void perf_phase_print(uint64_t bytes)
+{
+    if (!perf_enabled)
+        return;
+
+    double kb = bytes / 1024.0;
+    for (int line = 0; line < 2; ++line)
+    {
+        int from = line == 0 ? 0 : PERF_NR_HW;
+        int to = line == 0 ? PERF_NR_HW : PERF_NR_EVENTS;
+        int any = 0;
+
+        for (int i = from; i < to; ++i)
+        {
+            if (!perf_valid[i])
+                continue;
+            printf(any ? ", " : "    perf:     ");
+            any = 1;
+            if (i == PERF_TASK_CLOCK)
+                printf("%s %.2f ms", perf_events[i].name, perf_counts[i] / 1e6);
+            else
+                perf_print_count(perf_events[i].name, perf_counts[i], kb, perf_events[i].per_kb);
+            if (i == PERF_INSTRUCTIONS && perf_valid[PERF_CYCLES] && perf_counts[PERF_CYCLES])
+                printf(" (IPC %.2f)", (double)perf_counts[i] / perf_counts[PERF_CYCLES]);
+        }
+        if (any)
+            printf("\n");
+    }
+}
+
+#endif
@@ -0,0 +1,342 @@
+#ifndef RESULTS_H
+#define RESULTS_H
+
+/*
+ * Repeated-measurement statistics and machine readable output for the
+ * benchmark engine.
+ *
+ * Every phase is timed `reps` times; the summary is mean, sample standard
+ * deviation, min, max and the half-width of a 95% Student-t confidence
+ * interval of the mean. Records go to a JSON Lines (.json / .jsonl) or CSV
+ * (.csv) file, one per phase, each carrying the run metadata so a file can
+ * be loaded on its own into a dashboard.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/utsname.h>
+
+#include "bench_config.h"
+
+#define RESULTS_MAX_PHASES  16      /* five phases, or one per job */
+
+enum results_format { RESULTS_JSON, RESULTS_CSV };
+
+/* Where and on what the benchmark ran */
+struct run_meta {
+    char date[32];          /* start time, ISO 8601 UTC */
+    char host[65];
+    char kernel[65];
+    char fstype[32];
+    char device[128];       /* mount source of the test file's filesystem */
+};
+
+struct phase_result {
+    const char *name;
+    uint64_t bytes;         /* summed over the repetitions, which may differ */
+    uint64_t ops;
+    double *samples;        /* seconds, one per repetition */
+    int n;
+};
+
+struct phase_stats {
+    double mean;
+    double stddev;
+    double min;
+    double max;
+    double ci95;            /* half-width, mean +- ci95 */
+};
+
+struct results {
+    struct phase_result phases[RESULTS_MAX_PHASES];
+    int nr_phases;
+    int reps;
+};
+
+static FILE *results_fp;
+static enum results_format results_format;
+static struct run_meta results_meta;
+
+/* Two-sided 95% Student-t critical values for 1..30 degrees of freedom */
+static const double results_t95[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+};
+
+static double results_t_crit(int df)
+{
+    if (df < 1)
+        return 0;
+    if (df <= 30)
+        return results_t95[df - 1];
+    if (df <= 60)
+        return 2.000;
+    if (df <= 120)
+        return 1.980;
+    return 1.960;
+}
+
+/*
+ * Fill `meta` for the file at `path`: the filesystem type and device come
+ * from the /proc/self/mountinfo entry whose major:minor matches st_dev.
+ */
+static void results_collect_meta(struct run_meta *meta, const char *path)
+{
+    memset(meta, 0, sizeof(*meta));
+    strcpy(meta->fstype, "unknown");
+    strcpy(meta->device, "unknown");
+
+    time_t now = time(NULL);
+    strftime(meta->date, sizeof(meta->date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    gethostname(meta->host, sizeof(meta->host) - 1);
+
+    struct utsname uts;
+    if (uname(&uts) == 0)
+        snprintf(meta->kernel, sizeof(meta->kernel), "%s", uts.release);
+
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return;
+
+    FILE *fp = fopen("/proc/self/mountinfo", "r");
+    if (!fp)
+        return;
+
+    char line[4096];
+    while (fgets(line, sizeof(line), fp))
+    {
+        unsigned maj, min;
+        if (sscanf(line, "%*u %*u %u:%u", &maj, &min) != 2
+            || maj != major(st.st_dev) || min != minor(st.st_dev))
+            continue;
+
+        /* optional fields end at " - ", then fstype and mount source */
+        char *sep = strstr(line, " - ");
+        if (sep)
+            sscanf(sep + 3, "%31s %127s", meta->fstype, meta->device);
+    }
+    fclose(fp);
+}
+
+/* Open the output file; the format follows its extension */
+static int results_open(const char *path)
+{
+    const char *ext = strrchr(path, '.');
+    if (ext && (strcmp(ext, ".json") == 0 || strcmp(ext, ".jsonl") == 0))
+        results_format = RESULTS_JSON;
+    else if (ext && strcmp(ext, ".csv") == 0)
+        results_format = RESULTS_CSV;
+    else
+    {
+        fprintf(stderr, "%s: output must end in .json, .jsonl or .csv\n", path);
+        return -1;
+    }
+
+    results_fp = fopen(path, "w");
+    if (!results_fp)
+    {
+        perror("fopen");
+        return -1;
+    }
+
+    if (results_format == RESULTS_CSV)
+        fprintf(results_fp, "date,host,kernel,fstype,device,backend,file,file_size,"
+                "read_chunk,write_chunk,random_ops,dist,seed,phase,reps,"
+                "mean_sec,stddev_sec,min_sec,max_sec,ci95_sec,mb_s,iops\n");
+    return 0;
+}
+
+static void results_close(void)
+{
+    if (results_fp && fclose(results_fp) != 0)
+        perror("fclose");
+    results_fp = NULL;
+}
+
+static int results_init(struct results *r, int reps)
+{
+    memset(r, 0, sizeof(*r));
+    r->reps = reps;
+    for (int p = 0; p < RESULTS_MAX_PHASES; ++p)
+    {
+        r->phases[p].samples = malloc(reps * sizeof(double));
+        if (!r->phases[p].samples)
+        {
+            perror("malloc");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void results_free(struct results *r)
+{
+    for (int p = 0; p < RESULTS_MAX_PHASES; ++p)
+        free(r->phases[p].samples);
+}
+
+/* Start a new point/backend: forget the samples, keep the buffers */
+static void results_reset(struct results *r)
+{
+    for (int p = 0; p < RESULTS_MAX_PHASES; ++p)
+    {
+        r->phases[p].n = 0;
+        r->phases[p].bytes = 0;
+        r->phases[p].ops = 0;
+    }
+    r->nr_phases = 0;
+}
+
+/* Record one repetition of phase `idx`; the first call names the phase */
+static void results_add(struct results *r, int idx, const char *name,
+                        uint64_t bytes, uint64_t ops, double sec)
+{
+    struct phase_result *ph = &r->phases[idx];
+    ph->name = name;
+    if (ph->n < r->reps)
+    {
+        ph->samples[ph->n++] = sec;
+        ph->bytes += bytes;
+        ph->ops += ops;
+    }
+    if (idx >= r->nr_phases)
+        r->nr_phases = idx + 1;
+}
+
+static void results_stats(const struct phase_result *ph, struct phase_stats *s)
+{
+    memset(s, 0, sizeof(*s));
+    if (ph->n == 0)
+        return;
+
+    double sum = 0;
+    s->min = s->max = ph->samples[0];
+    for (int i = 0; i < ph->n; ++i)
+    {
+        sum += ph->samples[i];
+        if (ph->samples[i] < s->min)
+            s->min = ph->samples[i];
+        if (ph->samples[i] > s->max)
+            s->max = ph->samples[i];
+    }
+    s->mean = sum / ph->n;
+
+    if (ph->n > 1)
+    {
+        double sq = 0;
+        for (int i = 0; i < ph->n; ++i)
+            sq += (ph->samples[i] - s->mean) * (ph->samples[i] - s->mean);
+        s->stddev = sqrt(sq / (ph->n - 1));
+        s->ci95 = results_t_crit(ph->n - 1) * s->stddev / sqrt(ph->n);
+    }
+}
+
+static void results_json_str(FILE *fp, const char *key, const char *v)
+{
+    fprintf(fp, "\"%s\":\"", key);
+    for (; *v; ++v)
+    {
+        if (*v == '"' || *v == '\\')
+            fprintf(fp, "\\%c", *v);
+        else if ((unsigned char)*v < 0x20)
+            fprintf(fp, "\\u%04x", *v);
+        else
+            fputc(*v, fp);
+    }
+    fputs("\",", fp);
+}
+
+/* One quoted CSV field and its separator, doubling embedded quotes */
+static void results_csv_str(FILE *fp, const char *v)
+{
+    fputc('"', fp);
+    for (; *v; ++v)
+    {
+        if (*v == '"')
+            fputc('"', fp);
+        fputc(*v, fp);
+    }
+    fputs("\",", fp);
+}
+
+/* Print the summary of every phase and append the records to the output file */
+static void results_report(const struct results *r, const char *backend,
+                           const struct bench_config *cfg)
+{
+    const struct run_meta *m = &results_meta;
+
+    for (int p = 0; p < r->nr_phases; ++p)
+    {
+        const struct phase_result *ph = &r->phases[p];
+        if (ph->n == 0)
+            continue;
+
+        struct phase_stats s;
+        results_stats(ph, &s);
+        /* mean bytes over mean time, for phases that move more in some reps */
+        double mb_s = s.mean > 0 ? ph->bytes / (double)ph->n / 1048576.0 / s.mean : 0;
+        double iops = s.mean > 0 ? ph->ops / (double)ph->n / s.mean : 0;
+
+        if (r->reps > 1)
+            printf("%-25s:   %.4f +- %.4f sec (sd %.4f, min %.4f, n=%d)   %9.2f MB/s   %9.0f IOPS\n",
+                   ph->name, s.mean, s.ci95, s.stddev, s.min, ph->n, mb_s, iops);
+
+        if (!results_fp)
+            continue;
+
+        if (results_format == RESULTS_CSV)
+        {
+            results_csv_str(results_fp, m->date);
+            results_csv_str(results_fp, m->host);
+            results_csv_str(results_fp, m->kernel);
+            results_csv_str(results_fp, m->fstype);
+            results_csv_str(results_fp, m->device);
+            results_csv_str(results_fp, backend);
+            results_csv_str(results_fp, cfg->file_name);
+            fprintf(results_fp, "%zu,%zu,%zu,%d,", cfg->file_size, cfg->read_chunk,
+                    cfg->write_chunk, cfg->nums_random);
+            results_csv_str(results_fp, offset_dist_names[cfg->dist.kind]);
+            fprintf(results_fp, "%llu,", (unsigned long long)cfg->seed);
+            results_csv_str(results_fp, ph->name);
+            fprintf(results_fp, "%d,%.6f,%.6f,%.6f,%.6f,%.6f,%.2f,%.0f\n",
+                    ph->n, s.mean, s.stddev, s.min, s.max, s.ci95, mb_s, iops);
+            continue;
+        }
+
+        fputc('{', results_fp);
+        results_json_str(results_fp, "date", m->date);
+        results_json_str(results_fp, "host", m->host);
+        results_json_str(results_fp, "kernel", m->kernel);
+        results_json_str(results_fp, "fstype", m->fstype);
+        results_json_str(results_fp, "device", m->device);
+        results_json_str(results_fp, "backend", backend);
+        results_json_str(results_fp, "file", cfg->file_name);
+        fprintf(results_fp, "\"file_size\":%zu,\"read_chunk\":%zu,\"write_chunk\":%zu,"
+                "\"random_ops\":%d,", cfg->file_size, cfg->read_chunk, cfg->write_chunk,
+                cfg->nums_random);
+        results_json_str(results_fp, "dist", offset_dist_names[cfg->dist.kind]);
+        fprintf(results_fp, "\"seed\":%llu,", (unsigned long long)cfg->seed);
+        results_json_str(results_fp, "phase", ph->name);
+        fprintf(results_fp, "\"reps\":%d,\"mean_sec\":%.6f,\"stddev_sec\":%.6f,"
+                "\"min_sec\":%.6f,\"max_sec\":%.6f,\"ci95_sec\":%.6f,"
+                "\"mb_s\":%.2f,\"iops\":%.0f,\"samples_sec\":[",
+                ph->n, s.mean, s.stddev, s.min, s.max, s.ci95, mb_s, iops);
+        for (int i = 0; i < ph->n; ++i)
+            fprintf(results_fp, "%s%.6f", i ? "," : "", ph->samples[i]);
+        fputs("]}\n", results_fp);
+    }
+
+    if (results_fp)
+        fflush(results_fp);
+}
+
+#endif
@@ -0,0 +1,494 @@
+#include <unistd.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+
+#include "lat_hist.h"
+#include "parse_num.h"
+
+/*
+ * Metadata-heavy small-file workload:
+ *
+ *     ./smallfile -N 10000 -s 4K -D 16 -t 4
+ *
+ * N files of S bytes spread over D directories go through their whole
+ * life cycle, one phase per operation: create, write, fsync, close, stat,
+ * rename and unlink. The descriptors from create stay open until the close
+ * phase, so write and fsync time the pwrite and fsync alone, without a
+ * path lookup, open and close around them. Directory fsync runs after the
+ * phases that change directory entries, since that is what makes a
+ * create, rename or unlink durable.
+ * The cycle repeats for 1, 2, 4, ... threads up to -t; file i belongs to
+ * directory i % D and to thread i % threads.
+ */
+
+#define SMALL_DEFAULT_FILES     10000
+#define SMALL_DEFAULT_SIZE      4096
+#define SMALL_DEFAULT_DIRS      16
+#define SMALL_DEFAULT_ROOT      "smallfile.d"
+#define SMALL_PATH_MAX          512
+#define SMALL_MAX_DIRS          10000   /* d0000 .. d9999 */
+#define SMALL_MAX_THREADS       4096
+
+#define MEASURE_OPS(name, ops, hist, code_block) do {           \
+    struct timeval __tv1, __tv2;                                \
+    gettimeofday(&__tv1, NULL);                                 \
+    code_block                                                  \
+    gettimeofday(&__tv2, NULL);                                 \
+    double __sec = (__tv2.tv_sec - __tv1.tv_sec)                \
+        + (__tv2.tv_usec - __tv1.tv_usec) / 1000000.0;          \
+    printf("%-25s:   %.4f sec\n", name, __sec);                 \
+    printf("    %.0f ops/s, %d ops, avg=%.2f p50=%.2f p99=%.2f max=%.2f us\n", \
+           __sec > 0 ? (ops) / __sec : 0.0, (ops),              \
+           (hist)->count ? (hist)->sum / (double)(hist)->count / 1000.0 : 0.0, \
+           lat_percentile((hist), 50.0) / 1000.0,               \
+           lat_percentile((hist), 99.0) / 1000.0,               \
+           (hist)->max / 1000.0);                               \
+} while (0);
+
+enum meta_op {
+    META_CREATE, META_WRITE, META_FSYNC, META_CLOSE, META_DIRSYNC,
+    META_STAT, META_RENAME, META_UNLINK,
+};
+
+struct meta_phase {
+    const char *name;
+    enum meta_op op;
+};
+
+static const struct meta_phase meta_phases[] = {
+    { "1. Create",              META_CREATE },
+    { "2. Directory Fsync",     META_DIRSYNC },
+    { "3. Write",               META_WRITE },
+    { "4. Fsync",               META_FSYNC },
+    { "5. Close",               META_CLOSE },
+    { "6. Stat",                META_STAT },
+    { "7. Rename",              META_RENAME },
+    { "8. Directory Fsync",     META_DIRSYNC },
+    { "9. Unlink",              META_UNLINK },
+    { "10. Directory Fsync",    META_DIRSYNC },
+};
+
+#define NR_META_PHASES  (int)(sizeof(meta_phases) / sizeof(meta_phases[0]))
+
+static const char *root = SMALL_DEFAULT_ROOT;
+static int nfiles = SMALL_DEFAULT_FILES;
+static int ndirs = SMALL_DEFAULT_DIRS;
+static size_t fsize = SMALL_DEFAULT_SIZE;
+static char *fbuf;
+static int *fds;            /* file i's descriptor from create to close, else -1 */
+
+/* Start gate so worker creation stays outside the timed region */
+struct meta_gate {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int open;
+};
+
+struct meta_worker {
+    pthread_t tid;
+    struct meta_gate *gate;
+    enum meta_op op;
+    int first;              /* this worker handles items first, first + step, ... */
+    int step;
+    int ret;
+    struct lat_hist hist;   /* merged after join */
+};
+
+static void dir_path(char *p, int d)
+{
+    snprintf(p, SMALL_PATH_MAX, "%s/d%04d", root, d);
+}
+
+/* File i before the rename phase is "f<i>", after it "r<i>" */
+static void file_path(char *p, int i, int renamed)
+{
+    snprintf(p, SMALL_PATH_MAX, "%s/d%04d/%c%08d", root, i % ndirs, renamed ? 'r' : 'f', i);
+}
+
+static int meta_do(enum meta_op op, int i)
+{
+    char path[SMALL_PATH_MAX], path2[SMALL_PATH_MAX];
+    struct stat st;
+    int fd;
+
+    switch (op)
+    {
+    case META_CREATE:
+        file_path(path, i, 0);
+        if ((fds[i] = open(path, O_WRONLY | O_CREAT | O_EXCL, 0644)) == -1)
+        {
+            perror("open(O_CREAT)");
+            return -1;
+        }
+        return 0;
+
+    case META_WRITE:
+        if (pwrite(fds[i], fbuf, fsize, 0) != (ssize_t)fsize)
+        {
+            perror("pwrite");
+            return -1;
+        }
+        return 0;
+
+    case META_FSYNC:
+        if (fsync(fds[i]) != 0)
+        {
+            perror("fsync");
+            return -1;
+        }
+        return 0;
+
+    case META_CLOSE:
+        fd = fds[i];
+        fds[i] = -1;
+        if (close(fd) != 0)
+        {
+            perror("close");
+            return -1;
+        }
+        return 0;
+
+    case META_DIRSYNC:
+        dir_path(path, i);
+        if ((fd = open(path, O_RDONLY | O_DIRECTORY)) == -1)
+        {
+            perror("open(O_DIRECTORY)");
+            return -1;
+        }
+        if (fsync(fd) != 0)
+        {
+            perror("fsync(dir)");
+            close(fd);
+            return -1;
+        }
+        return close(fd);
+
+    case META_STAT:
+        file_path(path, i, 0);
+        if (stat(path, &st) != 0)
+        {
+            perror("stat");
+            return -1;
+        }
+        if ((size_t)st.st_size != fsize)
+        {
+            fprintf(stderr, "stat: %s is %lld bytes, expected %zu\n", path, (long long)st.st_size, fsize);
+            return -1;
+        }
+        return 0;
+
+    case META_RENAME:
+        file_path(path, i, 0);
+        file_path(path2, i, 1);
+        if (rename(path, path2) != 0)
+        {
+            perror("rename");
+            return -1;
+        }
+        return 0;
+
+    case META_UNLINK:
+        file_path(path, i, 1);
+        if (unlink(path) != 0)
+        {
+            perror("unlink");
+            return -1;
+        }
+        return 0;
+    }
+    return -1;
+}
+
+static void meta_gate_open(struct meta_gate *gate)
+{
+    pthread_mutex_lock(&gate->lock);
+    gate->open = 1;
+    pthread_cond_broadcast(&gate->cond);
+    pthread_mutex_unlock(&gate->lock);
+}
+
+static void *meta_worker_main(void *arg)
+{
+    struct meta_worker *w = arg;
+
+    pthread_mutex_lock(&w->gate->lock);
+    while (!w->gate->open)
+        pthread_cond_wait(&w->gate->cond, &w->gate->lock);
+    pthread_mutex_unlock(&w->gate->lock);
+
+    int items = w->op == META_DIRSYNC ? ndirs : nfiles;
+    for (int i = w->first; i < items; i += w->step)
+    {
+        uint64_t t0 = lat_now();
+        if (meta_do(w->op, i) != 0)
+        {
+            w->ret = -1;
+            break;
+        }
+        lat_record(&w->hist, lat_now() - t0);
+    }
+    return NULL;
+}
+
+/*
+ * Run one phase over all files (or all directories) split across
+ * `nthreads` workers. Directory fsync never uses more workers than there
+ * are directories.
+ */
+static int meta_run_phase(const struct meta_phase *ph, int nthreads)
+{
+    int items = ph->op == META_DIRSYNC ? ndirs : nfiles;
+    if (nthreads > items)
+        nthreads = items;
+
+    struct meta_worker *workers = calloc(nthreads, sizeof(*workers));
+    struct lat_hist *hist = calloc(1, sizeof(*hist));
+    if (!workers || !hist)
+    {
+        perror("calloc");
+        free(workers);
+        free(hist);
+        return -1;
+    }
+
+    struct meta_gate gate = {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .cond = PTHREAD_COND_INITIALIZER,
+        .open = 0,
+    };
+
+    int created = 0;
+    for (; created < nthreads; ++created)
+    {
+        struct meta_worker *w = &workers[created];
+        w->gate = &gate;
+        w->op = ph->op;
+        w->first = created;
+        w->step = nthreads;
+        int err = pthread_create(&w->tid, NULL, meta_worker_main, w);
+        if (err != 0)
+        {
+            fprintf(stderr, "pthread_create: %s\n", strerror(err));
+            break;
+        }
+    }
+
+    int ret = 0;
+    if (created != nthreads)
+    {
+        meta_gate_open(&gate);
+        for (int i = 0; i < created; ++i)
+            pthread_join(workers[i].tid, NULL);
+        free(workers);
+        free(hist);
+        return -1;
+    }
+
+    MEASURE_OPS(ph->name, items, hist, {
+        meta_gate_open(&gate);
+        for (int i = 0; i < nthreads; ++i)
+        {
+            pthread_join(workers[i].tid, NULL);
+            if (workers[i].ret != 0)
+                ret = -1;
+        }
+        for (int i = 0; i < nthreads; ++i)
+            lat_merge(hist, &workers[i].hist);
+    })
+
+    free(workers);
+    free(hist);
+    return ret;
+}
+
+/* Create the directory tree, untimed; an existing tree from a crashed run is reused */
+static int meta_setup(void)
+{
+    char path[SMALL_PATH_MAX];
+
+    if (mkdir(root, 0755) != 0 && errno != EEXIST)
+    {
+        perror(root);
+        return -1;
+    }
+    for (int d = 0; d < ndirs; ++d)
+    {
+        dir_path(path, d);
+        if (mkdir(path, 0755) != 0 && errno != EEXIST)
+        {
+            perror(path);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Close and remove whatever a failed cycle left behind, then the tree itself */
+static void meta_cleanup(void)
+{
+    char path[SMALL_PATH_MAX];
+
+    for (int i = 0; i < nfiles; ++i)
+    {
+        if (fds[i] != -1)
+            close(fds[i]);
+        fds[i] = -1;
+        file_path(path, i, 0);
+        unlink(path);
+        file_path(path, i, 1);
+        unlink(path);
+    }
+    for (int d = 0; d < ndirs; ++d)
+    {
+        dir_path(path, d);
+        rmdir(path);
+    }
+    rmdir(root);
+}
+
+static int run_cycle(int nthreads)
+{
+    printf("[threads=%d, %d files of %zu bytes in %d dirs]\n", nthreads, nfiles, fsize, ndirs);
+    if (meta_setup() != 0)
+        return -1;
+
+    int ret = 0;
+    for (int p = 0; p < NR_META_PHASES && ret == 0; ++p)
+        ret = meta_run_phase(&meta_phases[p], nthreads);
+
+    meta_cleanup();
+    return ret;
+}
+
+/*
+ * Every file is open from create to close: raise the soft descriptor
+ * limit as far as the hard limit allows, and fail early if that is short.
+ */
+static int meta_raise_nofile(void)
+{
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0)
+    {
+        perror("getrlimit");
+        return -1;
+    }
+
+    rlim_t need = (rlim_t)nfiles + 64;
+    if (rl.rlim_cur >= need)
+        return 0;
+    if (rl.rlim_max != RLIM_INFINITY && rl.rlim_max < need)
+    {
+        fprintf(stderr, "%d files need %llu descriptors, the hard limit is %llu: lower -N\n",
+                nfiles, (unsigned long long)need, (unsigned long long)rl.rlim_max);
+        return -1;
+    }
+    rl.rlim_cur = need;
+    if (setrlimit(RLIMIT_NOFILE, &rl) != 0)
+    {
+        perror("setrlimit");
+        return -1;
+    }
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-N files] [-s size] [-D dirs] [-t threads] [-d dir]\n"
+            "  -N files   number of files, all open at once between create and\n"
+            "             close, so at most the descriptor hard limit (default %d)\n"
+            "  -s size    bytes written to each file, with an optional K/M/G suffix (default %d)\n"
+            "  -D dirs    directories the files are spread over (default %d)\n"
+            "  -t threads run with 1, 2, 4, ... threads up to this many (default 1)\n"
+            "  -d dir     root of the tree, created and removed by the run (default %s)\n",
+            prog, SMALL_DEFAULT_FILES, SMALL_DEFAULT_SIZE, SMALL_DEFAULT_DIRS, SMALL_DEFAULT_ROOT);
+}
+
+int main(int argc, char *argv[])
+{
+    int max_threads = 1;
+    long n;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "N:s:D:t:d:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'N':
+            if (parse_count(optarg, 1, INT_MAX, "file count", &n) != 0)
+                return 1;
+            nfiles = n;
+            break;
+        case 's':
+            if (parse_size(optarg, &fsize) != 0)
+                return 1;
+            break;
+        case 'D':
+            if (parse_count(optarg, 1, SMALL_MAX_DIRS, "directory count", &n) != 0)
+                return 1;
+            ndirs = n;
+            break;
+        case 't':
+            if (parse_count(optarg, 1, SMALL_MAX_THREADS, "thread count", &n) != 0)
+                return 1;
+            max_threads = n;
+            break;
+        case 'd':
+            root = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind != argc)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (meta_raise_nofile() != 0)
+        return 1;
+
+    fbuf = malloc(fsize);
+    fds = malloc(nfiles * sizeof(*fds));
+    if (!fbuf || !fds)
+    {
+        perror("malloc");
+        free(fbuf);
+        free(fds);
+        return 1;
+    }
+    memset(fbuf, 'X', fsize);
+    for (int i = 0; i < nfiles; ++i)
+        fds[i] = -1;
+
+    int ret = 0;
+    for (int n = 1; ; n <<= 1)
+    {
+        if (n > max_threads)
+            n = max_threads;
+
+        if (run_cycle(n) != 0)
+        {
+            ret = 1;
+            break;
+        }
+        if (n == max_threads)
+            break;
+    }
+
+    free(fbuf);
+    free(fds);
+    return ret;
+}
@@ -0,0 +1,48 @@
+#!/bin/bash
+
+# Run the same workload matrix against every backend in one go.
+#
+#   ./sweep.sh -s 64M,100M -R 4K,64K -W 2K,4K -n 10000,50000
+#
+# All arguments are passed unchanged to each program, so stick to the
+# shared matrix options (-F -s -R -W -n, see ./HW111 -h) unless BACKENDS
+# is narrowed down. BACKENDS selects the programs, e.g.
+# BACKENDS="HW112 HW114" ./sweep.sh -R 4K:1M
+
+# Configuration
+FILE_NAME="100MB.bin"
+FILE_SIZE_MB=100
+BACKENDS=${BACKENDS:-"HW111 HW112 HW113 HW114"}
+
+echo "=========================================================="
+echo "    Workload Matrix Sweep: $BACKENDS"
+echo "    Matrix: $*"
+echo "=========================================================="
+
+# The programs resize the file to each point of the matrix; it only has to exist
+if [ ! -f "$FILE_NAME" ]; then
+    echo "Generating $FILE_SIZE_MB MB test file..."
+    gcc -O2 -pthread -o genfile genfile.c && ./genfile -s ${FILE_SIZE_MB}M $FILE_NAME
+    rm -f genfile
+fi
+
+for PROG in $BACKENDS; do
+    echo ""
+    echo ">>> Backend: $PROG"
+
+    gcc -O2 -pthread -o "$PROG" "$PROG.c" -lm
+    if [ $? -ne 0 ]; then
+        echo "   Error: Compilation of $PROG.c failed. Skipping..."
+        continue
+    fi
+
+    echo "----------------------------------------------------------"
+    ./"$PROG" "$@"
+    echo "----------------------------------------------------------"
+
+    rm "$PROG"
+done
+
+echo ""
+echo "Sweep completed."
+echo "=========================================================="
@@ -0,0 +1,168 @@
+#ifndef SYS_ACCT_H
+#define SYS_ACCT_H
+
+/*
+ * In-process system call and CPU accounting, so the library vs. syscall
+ * comparison does not have to run under strace -c, whose ptrace stops make
+ * every syscall several times slower.
+ *
+ * Two views per phase, both for the calling thread only (the -t sampler
+ * does not pollute them):
+ *  - call sites: every syscall the backends issue themselves goes through
+ *    SC(), which is one increment per call;
+ *  - kernel: the read/write-type syscall counts and bytes of
+ *    /proc/thread-self/io, which also see what the C library issues on
+ *    our behalf (stdio), plus user/sys CPU time and voluntary/involuntary
+ *    context switches from getrusage().
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#ifndef RUSAGE_THREAD
+#define RUSAGE_THREAD   RUSAGE_SELF
+#endif
+
+enum sc_call {
+    SC_PREAD, SC_PWRITE, SC_FSYNC, SC_MSYNC, SC_IO_URING_ENTER,
+    SC_LSEEK, SC_READ, SC_WRITE, SC_PREADV, SC_PWRITEV,
+    SC_NR_CALLS
+};
+
+static const char *const sc_names[SC_NR_CALLS] = {
+    "pread", "pwrite", "fsync", "msync", "io_uring_enter",
+    "lseek", "read", "write", "preadv", "pwritev",
+};
+
+static uint64_t sc_counts[SC_NR_CALLS];
+
+/* Count one call site; evaluates to the call's result */
+#define SC(nr, call)    (sc_counts[(nr)]++, (call))
+
+struct sys_usage {
+    uint64_t calls[SC_NR_CALLS];
+    uint64_t syscr;         /* read-type syscalls, /proc/.../io */
+    uint64_t syscw;         /* write-type syscalls */
+    uint64_t rchar;
+    uint64_t wchar;
+    struct timeval utime;
+    struct timeval stime;
+    long nvcsw;
+    long nivcsw;
+};
+
+static int sys_acct_enabled;
+static struct sys_usage sys_acct_start;
+static struct sys_usage sys_acct_stop;
+static uint64_t sys_acct_self_r;        /* reads of /proc/thread-self/io per begin/end pair */
+
+static inline void sys_usage_get(struct sys_usage *u)
+{
+    memset(u, 0, sizeof(*u));
+    memcpy(u->calls, sc_counts, sizeof(u->calls));
+
+    FILE *fp = fopen("/proc/thread-self/io", "r");
+    if (fp)
+    {
+        char key[32];
+        unsigned long long v;
+        while (fscanf(fp, "%31[^:]: %llu\n", key, &v) == 2)
+        {
+            if (strcmp(key, "syscr") == 0)
+                u->syscr = v;
+            else if (strcmp(key, "syscw") == 0)
+                u->syscw = v;
+            else if (strcmp(key, "rchar") == 0)
+                u->rchar = v;
+            else if (strcmp(key, "wchar") == 0)
+                u->wchar = v;
+        }
+        fclose(fp);
+    }
+
+    struct rusage ru;
+    if (getrusage(RUSAGE_THREAD, &ru) == 0)
+    {
+        u->utime = ru.ru_utime;
+        u->stime = ru.ru_stime;
+        u->nvcsw = ru.ru_nvcsw;
+        u->nivcsw = ru.ru_nivcsw;
+    }
+}
+
+static inline double sys_tv_sec(struct timeval a, struct timeval b)
+{
+    return (b.tv_sec - a.tv_sec) + (b.tv_usec - a.tv_usec) / 1000000.0;
+}
+
+/* Measure what reading our own counters adds to them, to subtract it */
+static inline void sys_acct_calibrate(void)
+{
+    struct sys_usage a, b;
+    sys_usage_get(&a);
+    sys_usage_get(&b);
+    sys_acct_self_r = b.syscr - a.syscr;
+}
+
+static inline void sys_acct_begin(void)
+{
+    if (sys_acct_enabled)
+        sys_usage_get(&sys_acct_start);
+}
+
+static inline void sys_acct_end(void)
+{
+    if (sys_acct_enabled)
+        sys_usage_get(&sys_acct_stop);
+}
+
+/* Read and write syscalls between the last sys_acct_begin() and sys_acct_end() */
+static inline uint64_t sys_acct_rw_calls(void)
+{
+    return (sys_acct_stop.syscr - sys_acct_start.syscr - sys_acct_self_r)
+        + (sys_acct_stop.syscw - sys_acct_start.syscw);
+}
+
+/* Calls counted by SC() between the last sys_acct_begin() and sys_acct_end() */
+static inline uint64_t sys_acct_issued(void)
+{
+    uint64_t n = 0;
+    for (int i = 0; i < SC_NR_CALLS; ++i)
+        n += sys_acct_stop.calls[i] - sys_acct_start.calls[i];
+    return n;
+}
+
+/* Print the difference between the last sys_acct_begin() and sys_acct_end() */
+static inline void sys_acct_print(void)
+{
+    if (!sys_acct_enabled)
+        return;
+
+    const struct sys_usage *s = &sys_acct_start;
+    struct sys_usage end = sys_acct_stop;
+
+    printf("    cpu:      user %.4f sec, sys %.4f sec, %ld voluntary / %ld involuntary switches\n",
+           sys_tv_sec(s->utime, end.utime), sys_tv_sec(s->stime, end.stime),
+           end.nvcsw - s->nvcsw, end.nivcsw - s->nivcsw);
+    printf("    kernel:   %llu read calls (%.2f MB), %llu write calls (%.2f MB)\n",
+           (unsigned long long)(end.syscr - s->syscr - sys_acct_self_r), (end.rchar - s->rchar) / 1048576.0,
+           (unsigned long long)(end.syscw - s->syscw), (end.wchar - s->wchar) / 1048576.0);
+
+    printf("    issued:  ");
+    int any = 0;
+    for (int i = 0; i < SC_NR_CALLS; ++i)
+    {
+        uint64_t n = end.calls[i] - s->calls[i];
+        if (n == 0)
+            continue;
+        printf("%s %s %llu", any ? "," : "", sc_names[i], (unsigned long long)n);
+        any = 1;
+    }
+    printf("%s\n", any ? "" : " none (library calls only)");
+}
+
+#endif
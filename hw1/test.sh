@@ -3,7 +3,7 @@
 # Configuration
 FILE_NAME="100MB.bin"
 FILE_SIZE_MB=100
-SOURCES=("HW111.c" "HW112.c" "HW113.c")
+SOURCES=("HW111.c" "HW112.c" "HW113.c" "HW114.c" "bench.c" "smallfile.c")
 COOL_DOWN_TIME=10 # Seconds to wait between tests
 
 # Check for root privileges (required to drop caches and run fstrim)
@@ -16,6 +16,13 @@ echo "=========================================================="
 echo "    File System I/O Benchmark Automation (Hardware Aware)"
 echo "=========================================================="
 
+# Test file generator (parallel, seeded), replaces dd from /dev/urandom
+gcc -O2 -pthread -o genfile genfile.c
+if [ $? -ne 0 ]; then
+    echo "Error: Compilation of genfile.c failed."
+    exit 1
+fi
+
 for SRC in "${SOURCES[@]}"; do
     PROG="${SRC%.c}" # Extract program name (e.g., HW111)
 
@@ -24,16 +31,16 @@ for SRC in "${SOURCES[@]}"; do
 
     # 1. Compilation
     echo "   [1/5] Compiling $SRC..."
-    gcc -o "$PROG" "$SRC"
+    gcc -pthread -o "$PROG" "$SRC" -lm
     if [ $? -ne 0 ]; then
         echo "   Error: Compilation of $SRC failed. Skipping..."
         continue
     fi
 
     # 2. Data Preparation
-    # Using /dev/urandom to bypass filesystem-level compression/deduplication
-    echo "   [2/5] Generating $FILE_SIZE_MB MB test file with dd..."
-    dd if=/dev/urandom of=$FILE_NAME bs=1M count=$FILE_SIZE_MB status=none
+    # Pseudo-random content to bypass filesystem-level compression/deduplication
+    echo "   [2/5] Generating $FILE_SIZE_MB MB test file..."
+    ./genfile -s ${FILE_SIZE_MB}M $FILE_NAME
 
     # 3. Environment Preparation (The "Cold Start" Protocol)
     # This ensures neither the OS nor the SSD Hardware buffers affect the result
@@ -59,7 +66,8 @@ for SRC in "${SOURCES[@]}"; do
     fi
 done
 
-# Final Cleanup of the test binary and data
+# Final Cleanup of the test binaries and data
+rm -f genfile
 if [ -f "$FILE_NAME" ]; then
     rm "$FILE_NAME"
 fi
@@ -0,0 +1,303 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/*
+ * Binary I/O traces: record the operations a benchmark issues and replay
+ * them against any backend, so stdio, syscalls and mmap run exactly the
+ * same access sequence. Traces captured elsewhere (e.g. from a service via
+ * strace or eBPF) can be converted to this format and fed in the same way.
+ *
+ * File layout: one struct trace_hdr followed by `count` struct trace_rec,
+ * in host byte order. A SYNC record makes [offset, offset + length)
+ * durable, or the whole file when length is 0.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "lat_hist.h"
+
+#define TRACE_MAGIC     "HWTRACE"
+#define TRACE_VERSION   1
+
+/* getopt() letters and usage text, to be merged into each program's own */
+#define TRACE_OPTS      "T:P:O"
+#define TRACE_USAGE                                                             \
+    "  -T file    record the issued operations to a trace file\n"              \
+    "  -P file    replay a trace instead of running the five phases\n"         \
+    "  -O         with -P, keep the recorded inter-arrival times\n"            \
+    "             (default: as fast as possible)\n"
+
+enum trace_op { TRACE_READ, TRACE_WRITE, TRACE_SYNC, TRACE_NR_OPS };
+
+struct trace_hdr {
+    char magic[8];
+    uint32_t version;
+    uint32_t rec_size;
+    uint64_t count;
+};
+
+struct trace_rec {
+    uint64_t offset;
+    uint64_t delta_ns;      /* issue time minus the previous record's */
+    uint32_t length;
+    uint8_t op;
+    uint8_t pad[3];
+};
+
+struct trace {
+    struct trace_rec *recs;
+    size_t n;
+    size_t cap;
+};
+
+/* Pacing state of one replay */
+struct trace_clock {
+    uint64_t due;           /* CLOCK_MONOTONIC ns the next op is scheduled for */
+    uint64_t late;          /* ops issued after their scheduled time */
+    uint64_t max_lag;
+};
+
+static const char *trace_record_file;
+static const char *trace_replay_file;
+static int trace_timed;
+
+static struct trace trace_out;
+static uint64_t trace_last_ns;
+
+/*
+ * Handle one of the TRACE_OPTS letters. Returns 1 if `opt` was consumed
+ * and 0 if it belongs to the caller.
+ */
+static int trace_option(int opt, const char *arg)
+{
+    switch (opt)
+    {
+    case 'T':
+        trace_record_file = arg;
+        return 1;
+    case 'P':
+        trace_replay_file = arg;
+        return 1;
+    case 'O':
+        trace_timed = 1;
+        return 1;
+    }
+    return 0;
+}
+
+static inline void trace_record(enum trace_op op, uint64_t offset, uint32_t length)
+{
+    if (trace_out.n == trace_out.cap)
+    {
+        size_t cap = trace_out.cap ? 2 * trace_out.cap : 65536;
+        struct trace_rec *recs = realloc(trace_out.recs, cap * sizeof(*recs));
+        if (!recs)
+        {
+            perror("trace: realloc");
+            trace_record_file = NULL;
+            return;
+        }
+        trace_out.recs = recs;
+        trace_out.cap = cap;
+    }
+
+    uint64_t now = lat_now();
+    struct trace_rec *r = &trace_out.recs[trace_out.n++];
+    memset(r, 0, sizeof(*r));
+    r->offset = offset;
+    r->delta_ns = trace_out.n == 1 ? 0 : now - trace_last_ns;
+    r->length = length;
+    r->op = op;
+    trace_last_ns = now;
+}
+
+/* Log an op when recording; costs one clock read and a store per call */
+#define TRACE(op, offset, length) do {                      \
+    if (trace_record_file)                                  \
+        trace_record((op), (offset), (length));             \
+} while (0)
+
+static int trace_save(const char *path, const struct trace *t)
+{
+    FILE *fp = fopen(path, "wb");
+    if (!fp)
+    {
+        perror("trace: fopen");
+        return -1;
+    }
+
+    struct trace_hdr hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    hdr.version = TRACE_VERSION;
+    hdr.rec_size = sizeof(struct trace_rec);
+    hdr.count = t->n;
+
+    if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1
+        || (t->n && fwrite(t->recs, sizeof(*t->recs), t->n, fp) != t->n))
+    {
+        perror("trace: fwrite");
+        fclose(fp);
+        return -1;
+    }
+    if (fclose(fp) != 0)
+    {
+        perror("trace: fclose");
+        return -1;
+    }
+
+    printf("Recorded %zu ops to %s\n", t->n, path);
+    return 0;
+}
+
+static int trace_load(const char *path, struct trace *t)
+{
+    memset(t, 0, sizeof(*t));
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+    {
+        perror("trace: fopen");
+        return -1;
+    }
+
+    struct trace_hdr hdr;
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1
+        || memcmp(hdr.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0
+        || hdr.version != TRACE_VERSION
+        || hdr.rec_size != sizeof(struct trace_rec))
+    {
+        fprintf(stderr, "%s: not a version %d trace\n", path, TRACE_VERSION);
+        fclose(fp);
+        return -1;
+    }
+    if (hdr.count > SIZE_MAX / sizeof(*t->recs))
+    {
+        fprintf(stderr, "%s: bad op count %llu\n", path, (unsigned long long)hdr.count);
+        fclose(fp);
+        return -1;
+    }
+
+    t->recs = malloc(hdr.count ? hdr.count * sizeof(*t->recs) : 1);
+    if (!t->recs)
+    {
+        perror("trace: malloc");
+        fclose(fp);
+        return -1;
+    }
+    if (fread(t->recs, sizeof(*t->recs), hdr.count, fp) != hdr.count)
+    {
+        fprintf(stderr, "%s: truncated trace\n", path);
+        free(t->recs);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+
+    t->n = t->cap = hdr.count;
+    return 0;
+}
+
+/*
+ * Reject traces that do not fit the current file: every op must stay
+ * within `file_size` bytes, which is also the size of the I/O buffer.
+ */
+static int trace_check(const struct trace *t, size_t file_size)
+{
+    for (size_t i = 0; i < t->n; ++i)
+    {
+        const struct trace_rec *r = &t->recs[i];
+        if (r->op >= TRACE_NR_OPS
+            || r->length > file_size || r->offset > file_size - r->length)
+        {
+            printf("   skipped: trace op %zu (op %u, %llu+%u) is outside the %zu byte file\n",
+                   i, r->op, (unsigned long long)r->offset, r->length, file_size);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static inline void trace_clock_start(struct trace_clock *clk)
+{
+    clk->due = lat_now();
+    clk->late = 0;
+    clk->max_lag = 0;
+}
+
+/*
+ * In original-timing mode, sleep until `r` is due. Ops are scheduled from
+ * the start of the replay rather than from the previous completion, so a
+ * slow op makes the following ones late instead of shifting the schedule.
+ */
+static inline void trace_wait(struct trace_clock *clk, const struct trace_rec *r)
+{
+    if (!trace_timed)
+        return;
+
+    clk->due += r->delta_ns;
+    uint64_t now = lat_now();
+    if (now < clk->due)
+    {
+        struct timespec ts = {
+            .tv_sec = clk->due / 1000000000ull,
+            .tv_nsec = clk->due % 1000000000ull,
+        };
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+            ;
+        return;
+    }
+
+    if (now - clk->due > 1000)
+    {
+        clk->late++;
+        if (now - clk->due > clk->max_lag)
+            clk->max_lag = now - clk->due;
+    }
+}
+
+/* Longest single op of `t`, which must fit the I/O buffer */
+static inline uint32_t trace_max_len(const struct trace *t)
+{
+    uint32_t max = 0;
+    for (size_t i = 0; i < t->n; ++i)
+        if (t->recs[i].length > max)
+            max = t->recs[i].length;
+    return max;
+}
+
+/* Bytes read and written by one pass over `t` */
+static inline uint64_t trace_bytes(const struct trace *t)
+{
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < t->n; ++i)
+        if (t->recs[i].op != TRACE_SYNC)
+            bytes += t->recs[i].length;
+    return bytes;
+}
+
+static void trace_print_summary(const struct trace *t, const struct trace_clock *clk)
+{
+    uint64_t ops[TRACE_NR_OPS] = { 0 };
+    uint64_t bytes[TRACE_NR_OPS] = { 0 };
+    for (size_t i = 0; i < t->n; ++i)
+    {
+        ops[t->recs[i].op]++;
+        bytes[t->recs[i].op] += t->recs[i].length;
+    }
+
+    printf("    reads %llu (%.2f MB), writes %llu (%.2f MB), syncs %llu\n",
+           (unsigned long long)ops[TRACE_READ], bytes[TRACE_READ] / 1048576.0,
+           (unsigned long long)ops[TRACE_WRITE], bytes[TRACE_WRITE] / 1048576.0,
+           (unsigned long long)ops[TRACE_SYNC]);
+    if (trace_timed)
+        printf("    late ops %llu, max lag %.2f us\n",
+               (unsigned long long)clk->late, clk->max_lag / 1000.0);
+}
+
+#endif
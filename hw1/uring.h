@@ -0,0 +1,260 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+#include "sys_acct.h"
+
+/*
+ * Minimal io_uring wrapper on top of the raw syscalls, so the benchmarks
+ * build with a plain gcc command line like the other programs (no liburing).
+ */
+struct uring {
+    int ring_fd;
+    unsigned entries;
+
+    void *sq_ptr;
+    size_t sq_size;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    void *cq_ptr;
+    size_t cq_size;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    unsigned to_submit;         /* SQEs queued but not yet handed to the kernel */
+    unsigned inflight;          /* SQEs handed to the kernel and not yet reaped */
+
+    int fd;                     /* fd (or fixed file index) to put into SQEs */
+    int sqe_flags;              /* IOSQE_FIXED_FILE when files are registered */
+    int fixed_bufs;             /* use READ_FIXED/WRITE_FIXED with buffer 0 */
+};
+
+static void uring_exit(struct uring *ring)
+{
+    munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ptr != ring->sq_ptr)
+        munmap(ring->cq_ptr, ring->cq_size);
+    munmap(ring->sq_ptr, ring->sq_size);
+    close(ring->ring_fd);
+}
+
+static int uring_init(struct uring *ring, unsigned entries, int fd, int fixed_file,
+                      char *buf, size_t buf_size, int fixed_bufs)
+{
+    memset(ring, 0, sizeof(*ring));
+
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    ring->ring_fd = syscall(__NR_io_uring_setup, entries, &p);
+    if (ring->ring_fd < 0)
+    {
+        perror("io_uring_setup");
+        return -1;
+    }
+    ring->entries = p.sq_entries;
+
+    ring->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (ring->cq_size > ring->sq_size)
+            ring->sq_size = ring->cq_size;
+        ring->cq_size = ring->sq_size;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED)
+    {
+        perror("mmap");
+        close(ring->ring_fd);
+        return -1;
+    }
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        ring->cq_ptr = ring->sq_ptr;
+    }
+    else
+    {
+        ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED)
+        {
+            perror("mmap");
+            munmap(ring->sq_ptr, ring->sq_size);
+            close(ring->ring_fd);
+            return -1;
+        }
+    }
+
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED)
+    {
+        perror("mmap");
+        if (ring->cq_ptr != ring->sq_ptr)
+            munmap(ring->cq_ptr, ring->cq_size);
+        munmap(ring->sq_ptr, ring->sq_size);
+        close(ring->ring_fd);
+        return -1;
+    }
+
+    char *sq = ring->sq_ptr;
+    ring->sq_head  = (unsigned *)(sq + p.sq_off.head);
+    ring->sq_tail  = (unsigned *)(sq + p.sq_off.tail);
+    ring->sq_mask  = (unsigned *)(sq + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + p.sq_off.array);
+
+    char *cq = ring->cq_ptr;
+    ring->cq_head  = (unsigned *)(cq + p.cq_off.head);
+    ring->cq_tail  = (unsigned *)(cq + p.cq_off.tail);
+    ring->cq_mask  = (unsigned *)(cq + p.cq_off.ring_mask);
+    ring->cqes     = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    ring->fd = fd;
+    if (fixed_file)
+    {
+        if (syscall(__NR_io_uring_register, ring->ring_fd,
+                    IORING_REGISTER_FILES, &fd, 1) != 0)
+        {
+            perror("io_uring_register(FILES)");
+            uring_exit(ring);
+            return -1;
+        }
+        ring->fd = 0;
+        ring->sqe_flags = IOSQE_FIXED_FILE;
+    }
+
+    if (fixed_bufs)
+    {
+        struct iovec iov = { .iov_base = buf, .iov_len = buf_size };
+        if (syscall(__NR_io_uring_register, ring->ring_fd,
+                    IORING_REGISTER_BUFFERS, &iov, 1) != 0)
+        {
+            perror("io_uring_register(BUFFERS)");
+            uring_exit(ring);
+            return -1;
+        }
+        ring->fixed_bufs = 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Grab the next free SQE. The caller must make sure the ring has room,
+ * callers do by bounding `inflight + to_submit` by the ring size.
+ */
+static struct io_uring_sqe *uring_get_sqe(struct uring *ring)
+{
+    unsigned tail = *ring->sq_tail + ring->to_submit;
+    unsigned idx = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[idx];
+
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[idx] = idx;
+    ring->to_submit++;
+    return sqe;
+}
+
+static void uring_prep_rw(struct uring *ring, int write, void *addr,
+                          unsigned len, off_t ofs, int link)
+{
+    struct io_uring_sqe *sqe = uring_get_sqe(ring);
+
+    if (ring->fixed_bufs)
+        sqe->opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+    else
+        sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->flags = ring->sqe_flags | (link ? IOSQE_IO_LINK : 0);
+    sqe->fd = ring->fd;
+    sqe->addr = (uintptr_t)addr;
+    sqe->len = len;
+    sqe->off = ofs;
+    sqe->buf_index = 0;
+    sqe->user_data = len;       /* expected result, checked on completion */
+}
+
+static void uring_prep_fsync(struct uring *ring)
+{
+    struct io_uring_sqe *sqe = uring_get_sqe(ring);
+
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->flags = ring->sqe_flags;
+    sqe->fd = ring->fd;
+    sqe->user_data = 0;
+}
+
+/*
+ * Publish queued SQEs and wait until at most `max_inflight` remain in
+ * flight, reaping and checking every completion on the way.
+ */
+static int uring_submit_and_wait(struct uring *ring, unsigned max_inflight)
+{
+    unsigned submit = ring->to_submit;
+    if (submit)
+    {
+        __atomic_store_n(ring->sq_tail, *ring->sq_tail + submit, __ATOMIC_RELEASE);
+        ring->to_submit = 0;
+        ring->inflight += submit;
+    }
+
+    while (submit || ring->inflight > max_inflight)
+    {
+        unsigned wait = ring->inflight > max_inflight ? ring->inflight - max_inflight : 0;
+        int ret = SC(SC_IO_URING_ENTER,
+                     syscall(__NR_io_uring_enter, ring->ring_fd, submit, wait,
+                             wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0));
+        if (ret < 0)
+        {
+            perror("io_uring_enter");
+            return -1;
+        }
+        submit -= ret;
+
+        unsigned head = *ring->cq_head;
+        unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head)
+        {
+            struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+            if (cqe->res != (int)cqe->user_data)
+            {
+                fprintf(stderr, "io_uring: expected %llu, got %d (%s)\n",
+                        (unsigned long long)cqe->user_data, cqe->res,
+                        cqe->res < 0 ? strerror(-cqe->res) : "short I/O");
+                __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+                return -1;
+            }
+            ring->inflight--;
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+    return 0;
+}
+
+static int uring_fsync(struct uring *ring)
+{
+    uring_prep_fsync(ring);
+    return uring_submit_and_wait(ring, 0);
+}
+
+#endif